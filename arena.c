@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "arena.h"
+
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+static void* arena_base;
+static size_t arena_bytes;
+static const char* backing = "none";
+
+/* Maps a zeroed arena of at least bytes. Returns NULL if it can't. Only one
+  arena exists at a time; a second call replaces the first. */
+void* arena_alloc(size_t bytes, HugePageMode mode)
+{
+  void* p = MAP_FAILED;
+
+  arena_free();
+  if(bytes == 0)
+    bytes = 1;
+
+  if(mode == Huge_EXPLICIT)
+  {
+#ifdef MAP_HUGETLB
+    size_t rounded = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    p = mmap(NULL, rounded, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(p != MAP_FAILED)
+    {
+      bytes = rounded;
+      backing = "explicit huge pages";
+    }
+#endif
+    if(p == MAP_FAILED)
+      fprintf(stderr, "No huge pages available, using normal pages.\n");
+  }
+
+  if(p == MAP_FAILED)
+  {
+    p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED)
+      return NULL;
+    backing = "normal pages";
+#ifdef MADV_HUGEPAGE
+    if(mode == Huge_THP && madvise(p, bytes, MADV_HUGEPAGE) == 0)
+      backing = "transparent huge pages";
+#endif
+  }
+
+  arena_base = p;
+  arena_bytes = bytes;
+  return p;
+}
+
+void arena_free()
+{
+  if(arena_base != NULL)
+    munmap(arena_base, arena_bytes);
+  arena_base = NULL;
+  arena_bytes = 0;
+  backing = "none";
+}
+
+size_t arena_size()
+{
+  return arena_bytes;
+}
+
+const char* arena_backing()
+{
+  return backing;
+}
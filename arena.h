@@ -0,0 +1,27 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+/* The cache metadata for every level lives in one arena, so a multi-gigabyte
+simulated cache is a single mapping that can be backed by huge pages instead
+of thousands of small heap allocations.
+
+	Huge_NONE      normal pages
+	Huge_THP       ask for transparent huge pages with madvise()
+	Huge_EXPLICIT  map from the hugetlbfs pool (MAP_HUGETLB), falling back to
+	               normal pages if the pool is empty
+*/
+typedef enum
+{
+	Huge_NONE,
+	Huge_THP,
+	Huge_EXPLICIT,
+} HugePageMode;
+
+void* arena_alloc(size_t bytes, HugePageMode mode);
+void arena_free();
+size_t arena_size();
+const char* arena_backing();
+
+#endif
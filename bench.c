@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "cachesim.h"
+#include "workload.h"
+#include "bench.h"
+
+/*
+Usage:
+	./cachesim bench [-n accesses] [-w workload]... [-a list] [-b list] [-l list]
+
+Runs every workload against a matrix of D-cache geometries and prints one JSON
+object per line for each run, so results can be diffed or loaded into a
+spreadsheet to track regressions over time.
+
+	-n  accesses per run (default 200000)
+	-w  workload spec, see workload.h (may be repeated; default is all six)
+	-a  comma separated associativities (default 1,2,4,8,16,32,64)
+	-b  comma separated words per block (default 1,2,4,8,16)
+	-l  comma separated number of D-cache levels (default 1,2,3)
+
+The L1 D-cache always holds 8192 words; L2 is 8 times and L3 64 times that.
+Every level is write-back, write-allocate with LRU replacement. Each run
+happens in its own child process so the peak RSS is that run's alone.
+*/
+
+#define BENCH_VERSION 1
+#define BENCH_CHUNK 4096
+#define L1_WORDS 8192
+#define MAX_LIST 16
+
+static const char* default_workloads[] =
+{
+	"seq:footprint=4M",
+	"stride:footprint=4M:stride=256",
+	"random:footprint=4M:reads=0.7",
+	"zipf:footprint=16M:reads=0.7",
+	"chase:footprint=4M",
+	"mixed:footprint=4M:reads=0.7",
+};
+
+static double now_seconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+/* Parses "1,2,4" into list and returns how many numbers there were */
+static int parse_list(const char* s, int* list)
+{
+  int n = 0;
+  char* end;
+  while(*s != '\0' && n < MAX_LIST)
+  {
+    list[n] = strtol(s, &end, 10);
+    if(end == s || list[n] <= 0)
+      return 0;
+    n++;
+    s = (*end == ',') ? end + 1 : end;
+  }
+  return n;
+}
+
+/* Simulates one workload on one geometry and prints its result line. This
+  runs in a child process. */
+static void bench_run(const WorkloadInfo* info, int levels, int assoc, int words_per_block)
+{
+  CacheInfo icache = { 1024, 4, 2, Replacement_LRU, Write_WRITE_BACK, Allocate_ALLOCATE, Index_PLAIN };
+  CacheInfo dcache[3];
+  CacheStats istats, dstats[3];
+  Workload w;
+  MemAccess batch[BENCH_CHUNK];
+  struct rusage usage;
+  double start, elapsed = 0;
+  unsigned long done = 0;
+  int n, level;
+
+  memset(dcache, 0, sizeof(dcache));
+  for(level = 0; level < levels; level++)
+  {
+    dcache[level].num_blocks = (L1_WORDS << (3 * level)) / words_per_block;
+    dcache[level].words_per_block = words_per_block;
+    dcache[level].associativity = assoc < dcache[level].num_blocks ? assoc : dcache[level].num_blocks;
+    dcache[level].replacement = Replacement_LRU;
+    dcache[level].write_scheme = Write_WRITE_BACK;
+    dcache[level].allocate_scheme = Allocate_ALLOCATE;
+  }
+  configure_caches(icache, dcache, levels);
+  setup_caches();
+
+  /* Only the simulation is timed, not the generator */
+  workload_init(&w, info);
+  while(1)
+  {
+    for(n = 0; n < BENCH_CHUNK && workload_next(&w, &batch[n].type, &batch[n].address); n++)
+      ;
+    if(n == 0)
+      break;
+    start = now_seconds();
+    handle_accesses(batch, n);
+    elapsed += now_seconds() - start;
+    done += n;
+  }
+  workload_free(&w);
+
+  get_cache_stats(&istats, dstats);
+  getrusage(RUSAGE_SELF, &usage);
+  printf("{\"bench\":%d,\"workload\":\"%s\",\"footprint\":%lu,\"levels\":%d,"
+    "\"associativity\":%d,\"words_per_block\":%d,\"accesses\":%lu,"
+    "\"seconds\":%.6f,\"accesses_per_sec\":%.0f,\"ns_per_access\":%.3f,"
+    "\"peak_rss_kb\":%ld,\"l1d_reads\":%lld,\"l1d_read_misses\":%lld,\"status\":\"ok\"}\n",
+    BENCH_VERSION, workload_name(info->kind), info->footprint, levels,
+    assoc, words_per_block, done, elapsed,
+    elapsed > 0 ? done / elapsed : 0.0, done > 0 ? elapsed * 1e9 / done : 0.0,
+    usage.ru_maxrss, dstats[0].num_reads,
+    dstats[0].compulsory_reads + dstats[0].conflict_reads + dstats[0].capacity_reads);
+  fflush(stdout);
+}
+
+int bench_main(int argc, char** argv)
+{
+  int assocs[MAX_LIST] = { 1, 2, 4, 8, 16, 32, 64 };
+  int blocks[MAX_LIST] = { 1, 2, 4, 8, 16 };
+  int level_counts[MAX_LIST] = { 1, 2, 3 };
+  int num_assocs = 7, num_blocks = 5, num_levels = 3;
+  const char* specs[MAX_LIST];
+  int num_specs = 0;
+  unsigned long count = 200000;
+  WorkloadInfo info;
+  int i, s, l, a, b, status;
+  pid_t pid;
+
+  for(i = 1; i < argc; i++)
+  {
+    if(i == argc - 1)
+    {
+      fprintf(stderr, "Expected a value after %s.\n", argv[i]);
+      return 1;
+    }
+    if(strcmp(argv[i], "-n") == 0)
+      count = strtoul(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "-w") == 0 && num_specs < MAX_LIST)
+      specs[num_specs++] = argv[++i];
+    else if(strcmp(argv[i], "-a") == 0)
+      num_assocs = parse_list(argv[++i], assocs);
+    else if(strcmp(argv[i], "-b") == 0)
+      num_blocks = parse_list(argv[++i], blocks);
+    else if(strcmp(argv[i], "-l") == 0)
+      num_levels = parse_list(argv[++i], level_counts);
+    else
+    {
+      fprintf(stderr, "Unknown bench option %s.\n", argv[i]);
+      return 1;
+    }
+  }
+  if(num_specs == 0)
+  {
+    for(num_specs = 0; num_specs < 6; num_specs++)
+      specs[num_specs] = default_workloads[num_specs];
+  }
+  if(count == 0 || num_assocs == 0 || num_blocks == 0 || num_levels == 0)
+  {
+    fprintf(stderr, "Invalid bench parameters.\n");
+    return 1;
+  }
+  /* Every level holds a power of two words, so these keep the set counts
+    powers of two as the plain index needs */
+  for(a = 0; a < num_assocs; a++)
+  {
+    if(power_of_two(assocs[a]) < 0)
+    {
+      fprintf(stderr, "Associativities must be powers of two.\n");
+      return 1;
+    }
+  }
+  for(b = 0; b < num_blocks; b++)
+  {
+    if(power_of_two(blocks[b]) < 0 || blocks[b] > L1_WORDS)
+    {
+      fprintf(stderr, "Words per block must be powers of two up to %d.\n", L1_WORDS);
+      return 1;
+    }
+  }
+  for(l = 0; l < num_levels; l++)
+  {
+    if(level_counts[l] > 3)
+    {
+      fprintf(stderr, "At most 3 D-cache levels can be benchmarked.\n");
+      return 1;
+    }
+  }
+
+  for(s = 0; s < num_specs; s++)
+  {
+    if(parse_workload(specs[s], &info) != 0)
+    {
+      fprintf(stderr, "Invalid workload %s.\n", specs[s]);
+      return 1;
+    }
+    info.count = count;
+    for(l = 0; l < num_levels; l++)
+    for(a = 0; a < num_assocs; a++)
+    for(b = 0; b < num_blocks; b++)
+    {
+      fflush(stdout);
+      pid = fork();
+      if(pid == 0)
+      {
+        bench_run(&info, level_counts[l], assocs[a], blocks[b]);
+        _exit(0);
+      }
+      if(pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      {
+        /* Still report the run so a crash shows up as a regression */
+        printf("{\"bench\":%d,\"workload\":\"%s\",\"footprint\":%lu,\"levels\":%d,"
+          "\"associativity\":%d,\"words_per_block\":%d,\"status\":\"failed\"}\n",
+          BENCH_VERSION, workload_name(info.kind), info.footprint, level_counts[l],
+          assocs[a], blocks[b]);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,8 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+/* cachesim bench - measures how fast the simulator itself runs. See bench.c
+for the options and the output format. */
+int bench_main(int argc, char** argv);
+
+#endif
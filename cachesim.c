@@ -3,6 +3,24 @@
 #include <string.h>
 #include <time.h>
 #include "cachesim.h"
+#include "workload.h"
+#include "bench.h"
+#include "dse.h"
+#include "check.h"
+#include "profile.h"
+#include "arena.h"
+#include "prefetch.h"
+#include "timing.h"
+#include "dram.h"
+#include "coherence.h"
+#include "multicore.h"
+#include "victim.h"
+#include "writebuf.h"
+#include "tlb.h"
+#include "partition.h"
+#include "hotspot.h"
+#include "refmodel.h"
+#include "statsfile.h"
 
 /*
 Usage:
@@ -38,6 +56,97 @@ file where every line is of the form:
 	0x00000000 R
 A hexadecimal address, followed by a space and then R, W, or I for data read,
 data write, or instruction fetch, respectively.
+
+The trace can also be a FIFO or - for standard input, and can come from
+Valgrind Lackey, DineroIV din or ChampSim binary traces; the format is detected
+unless --format native|lackey|din|champsim gives it (see trace.h):
+	valgrind --tool=lackey --trace-mem=yes ./prog 2>&1 | ./cachesim -I 4096:1:2:R -D 1:4096:2:4:R:B:A -
+
+Instead of a trace file, -W runs a built-in synthetic workload (see workload.h):
+	./cachesim -I 4096:1:2:R -D 1:4096:2:4:R:B:A -W zipf:footprint=1M:n=1000000
+
+An optional last item on -I or -D picks how blocks are spread over the sets:
+plain (low address bits, the default), xor (all the upper bits XOR-folded),
+mod (block number modulo the set count, which then needn't be a power of two),
+prime (mod with the set count cut down to a prime) or skew (a different hash
+for each way):
+	./cachesim -I 4096:1:2:R:xor -D 1:4096:2:4:L:B:A:skew trace.txt
+
+-P attaches a hardware prefetcher to a D-cache level (see prefetch.h):
+	./cachesim -I 4096:1:2:R -D 1:4096:2:4:R:B:A -P 1:stride:degree=4 trace.txt
+
+-V attaches a small fully-associative victim or miss cache to a D-cache level
+(see victim.h):
+	./cachesim -I 4096:1:2:R -D 1:4096:2:1:R:B:A -V 1:victim:8 trace.txt
+
+-B puts a write buffer with write combining after a write-through D-cache level
+(see writebuf.h):
+	./cachesim -I 4096:1:2:R -D 1:4096:2:4:R:T:N -D 2:65536:4:8:L:B:A -B 1:8 trace.txt
+
+-S <level>:<words> makes a D-cache level sectored: blocks keep a valid and dirty
+bit per sector, fills read only the sector that is needed and writebacks only
+the dirty sectors:
+	./cachesim -I 4096:1:2:R -D 1:1024:16:4:L:B:A -S 1:2 trace.txt
+
+-C partitions the ways of a D-cache level between cores or address ranges,
+with CAT-style way masks or utility-based partitioning (see partition.h):
+	./cachesim --cores 2 -I 4096:1:2:R -D 1:4096:2:4:R:B:A -D 2:65536:4:16:L:B:A -C 2:ucp:core0,core1 core0.txt core1.txt
+
+--hot <k> lists the k blocks and 4 KB regions (or region=<bytes>) with the
+most misses and writebacks at every level, found with bounded-memory
+streaming sketches (see hotspot.h):
+	./cachesim -I 4096:1:2:R -D 1:4096:2:4:R:B:A --hot 10:region=64K trace.txt
+
+-T adds an I-TLB, D-TLB or shared L2 TLB, --pages sets the page sizes and
+--page-walk sends the page table loads of TLB misses through the D-caches
+(see tlb.h):
+	./cachesim -I 4096:1:2:R -D 1:4096:2:4:R:B:A -T D:64:4 -T L2:1024:8 --page-walk trace.txt
+
+-L and -M turn on the timing model and set per-level latencies and MSHRs and
+the memory latency and bandwidth (see timing.h):
+	./cachesim -I 4096:1:2:R -D 1:4096:2:4:R:B:A -L 1:2:8 -M 200:4 trace.txt
+
+--dram models main memory below the last D-cache level, with channels, banks
+and row buffers, on the timing model's clock (see dram.h):
+	./cachesim -I 4096:1:2:R -D 1:4096:2:4:R:B:A -L 1:2:8 -M 200:4 --dram channels=2:policy=closed trace.txt
+
+--cores simulates several cores with private I-caches and L1 D-caches kept
+coherent with MESI, sharing L2 and L3 (see coherence.h). It takes either one
+trace with a core number after each access type or one trace per core:
+	./cachesim --cores 2 -I 4096:1:2:R -D 1:4096:2:4:R:B:A -D 2:65536:4:8:L:B:A core0.txt core1.txt
+
+--compact simulates each run of accesses of one type to one L1 block once and
+counts the rest of the run as the hits they are; the statistics don't change:
+	./cachesim --compact -I 4096:1:2:R -D 1:4096:2:4:R:B:A trace.txt
+
+--check runs a slow reference model of the caches (see refmodel.h) in
+lockstep with the simulator and stops at the first access where the two
+disagree on a statistic or on the contents of a set, printing the sets the
+access touched in both. It only covers caches without the extras above:
+	./cachesim --check -I 4096:1:2:R -D 1:4096:2:4:R:B:A -D 2:65536:4:8:L:B:A trace.txt
+
+--stats-out and --stats-json save the configuration and statistics to a
+binary or JSON file, with misses per set under --set-misses, so that runs
+over pieces of a trace can be added up with merge (see statsfile.h):
+	./cachesim -I 4096:1:2:R -D 1:4096:2:4:R:B:A --stats-out part1.stats part1.txt
+	./cachesim merge -j total.json part1.stats part2.stats part3.stats
+
+--hugepages thp|explicit backs the cache metadata with transparent or
+hugetlbfs huge pages, which helps TLB reach when simulating very big caches.
+
+--profile prints where the simulator's own time went, per phase and per cache
+level, after the statistics. It needs a build with make PROFILE=1.
+
+There are also five subcommands:
+	./cachesim gen <workload>     writes a workload out as a trace file
+	./cachesim bench [options]    measures simulator throughput (see bench.c)
+	./cachesim dse [options]      searches D-cache hierarchies for the Pareto
+	                              front of miss rate, AMAT and traffic against
+	                              size (see dse.c)
+	./cachesim check [options]    runs --check on random hierarchies and
+	                              workloads (see check.c)
+	./cachesim merge <files>      adds up statistics saved by --stats-out
+	                              (see statsfile.h)
 */
 
 /* These global variables will hold the info needed to set up your caches in
@@ -48,11 +157,146 @@ static CacheInfo icache_info;
 static CacheInfo dcache_info[3];
 static CacheSetup icache_setup, dcache_setup[3];
 static CacheStats icache_stats, dcache_stats[3];
+static WorkloadInfo workload_info;
+static int have_workload;
+static int want_profile;
+
+CacheArray icache;
+CacheArray dcache;
+CacheArray dcache2;
+CacheArray dcache3;
+static HugePageMode huge_pages;
+
+/* Prefetchers attached with -P, and the prefetches each has in flight */
+#define PREFETCH_QUEUE 64
+#define POLLUTION_SIZE 1024
+typedef struct
+{
+  unsigned long block;
+  unsigned long due;
+} PendingPrefetch;
+static PrefetchInfo prefetch_info[3];
+static Prefetcher prefetchers[3];
+static PrefetchStats prefetch_stats[3];
+static PendingPrefetch prefetch_queue[3][PREFETCH_QUEUE];
+static int prefetch_queued[3];
+static unsigned long prefetch_clock[3];
+static unsigned long pollution[3][POLLUTION_SIZE];
+static CacheBlock* set_snapshot[3];
+static int prefetching[3];
+
+/* How far down the D-cache levels the current demand access has read; equal
+  to the number of levels if it went to memory. Only used for timing. */
+static int demand_level;
+static int num_dlevels;
+
+/* Cycles the DRAM model took to serve the current demand access, or -1 if it
+  didn't go to memory */
+static long memory_latency = -1;
+static unsigned long long accesses_seen;
+
+/* The cycle a request leaving the last level reaches the DRAM model. --dram
+  needs the timing model, whose clock moves with the work the caches do. */
+static unsigned long long memory_clock()
+{
+  return timing_now();
+}
+static size_t metadata_block_bytes;
+
+/* Victim and miss caches attached with -V */
+static VictimCache victim_caches[3];
 
-CacheBlock** icache;
-CacheBlock** dcache;
-CacheBlock** dcache2;
-CacheBlock** dcache3;
+/* Write buffers attached with -B */
+static WriteBuffer write_buffers[3];
+
+/* Sectored levels (-S): words per sector, or 0 for whole blocks. Their
+  traffic is also added up as the whole-block model would have charged it. */
+typedef struct
+{
+  int sector_misses;       /* the tag hit but the sector wasn't there */
+  int words_read, words_written;
+  int block_words_read, block_words_written;
+} SectorStats;
+static int sector_words[3];
+static SectorStats sector_stats[3];
+
+/* With --page-walk, TLB misses load page table entries through the
+  D-caches; this is what those loads cost */
+typedef struct
+{
+  int loads;
+  int l1_misses;
+  int words_read_mem;   /* from memory, below the last D-cache level */
+} WalkStats;
+static int page_walks;
+static WalkStats walk_stats;
+
+/* A skewed cache is accessed through a one-set scratch array holding the ways
+  a block can go in ([0] is the I-cache's) */
+#define MAX_SKEW_WAYS 16
+static CacheArray skew_sets[4];
+static unsigned long skew_clock;
+
+static const char* index_names[] = { "plain", "xor", "mod", "prime", "skew" };
+
+/* Way partitioning per D-cache level, and the class and miss count of the
+  access each level is in the middle of */
+static Partition partitions[3];
+static int partition_cls[3], partition_misses[3];
+
+/* --hot: top blocks and regions by misses and writebacks for the I-cache
+  ([0]) and each D-cache level, and the miss count each access started at */
+enum { Hot_BLOCK_MISSES, Hot_REGION_MISSES, Hot_BLOCK_WRITEBACKS, Hot_REGION_WRITEBACKS };
+static int hot_k, hot_region_bits;
+static HotTracker hot_trackers[4][4];
+static long long hot_misses[4];
+
+/* --stats-out and --stats-json save the statistics for merge (see
+  statsfile.h), with misses per set for each cache under --set-misses.
+  watch_misses is set if anything needs to see each miss. */
+static const char* stats_out_path;
+static const char* stats_json_path;
+static int set_histograms, watch_misses;
+static long long* set_misses[4];
+
+/* MRU fast path: the block each cache ([0] is the I-cache) last touched, as
+  block number + 1 (0 for none), and where it sits. A repeat access to it is a
+  hit on the most recently used way, which changes nothing but the counters
+  and, for a write-back write, the dirty bit. fast_path says which caches can
+  take it; the extras that watch every access turn it off. */
+static unsigned long mru_block[4];
+static int mru_row[4], mru_col[4];
+static int fast_path[4];
+
+/* --compact: runs of accesses of one type to one L1 block are simulated once
+  and the repeats credited as fast path hits */
+static int compact_runs;
+
+/* --check: the reference model in refmodel.c follows every access too, and
+  both must agree on the statistics and on each set the access touched */
+static int check_accesses;
+static RefModel reference;
+static unsigned long long checked;
+
+static void note_mru(int x, unsigned long block, int row, int col)
+{
+  mru_block[x] = block + 1;
+  mru_row[x] = row;
+  mru_col[x] = col;
+}
+
+/* With --cores each core has its own I-cache and L1 D-cache. The core being
+  simulated has its caches in the usual globals and the others are parked
+  here; switch_core() swaps them. */
+typedef struct
+{
+	CacheArray icache, dcache;
+	CacheStats icache_stats, dcache_stats;
+} CoreContext;
+static CoreContext cores[MAX_CORES];
+static int num_cores = 1, current_core;
+static TraceReader* core_traces[MAX_CORES];
+static TraceFormat trace_format;
 
 unsigned int tag_I, tag_D[3];
 int word_index_I, row_index_I, col_index_I;
@@ -74,48 +318,49 @@ int power_of_two(int n)
   }
   return count;
 }
+static int is_prime(int n)
+{
+  int d;
+  for(d = 2; d * d <= n; d++)
+  {
+    if(n % d == 0)
+      return 0;
+  }
+  return n > 1;
+}
+/* Makes col the most recently used way of row and ages every way that was
+  more recent than it. A way that was never filled still holds its initial
+  rank, which is the number of valid ways before it, so filling it ages
+  exactly the valid ones. */
+static void touch_lru(CacheArray* cache, int row, int col)
+{
+  unsigned int rank = lru_rank(cache, row, col);
+  unsigned int r;
+  int j;
+  for(j = 0; j < cache->num_cols; j++)
+  {
+    r = lru_rank(cache, row, j);
+    if(r < rank)
+      set_lru_rank(cache, row, j, r + 1);
+  }
+  set_lru_rank(cache, row, col, 0);
+}
 /* Updates a given block to MRU and increments age of all other blocks in icache */
 void updateAge(int col)
 {
   /* Update LRU ages */
   if(icache_info.replacement == Replacement_LRU)
   {
-    icache[row_index_I][col].LRU_age = 1;
-    int j;
-    for(j = 0; j < icache_setup.num_cols; j++)
-    {
-      if(icache[row_index_I][j].LRU_age == 0)
-      {
-        /* This block and the rest have not been used yet */
-        break;
-      }
-      else if(j != col)
-      {
-        icache[row_index_I][j].LRU_age++;
-      }
-    }
+    touch_lru(&icache, row_index_I, col);
   }
 }
 /* Updates a given block to MRU and increments age of all other blocks in dcache */
-void updateAgeD(int col, int level, CacheBlock** cache)
+void updateAgeD(int col, int level, CacheArray* cache)
 {
   /* Update LRU ages */
   if(dcache_info[level].replacement == Replacement_LRU)
   {
-    cache[row_index_D[level]][col].LRU_age = 1;
-    int j;
-    for(j = 0; j < dcache_setup[level].num_cols; j++)
-    {
-      if(cache[row_index_D[level]][j].LRU_age == 0)
-      {
-        /* This block and the rest have not been used yet */
-        break;
-      }
-      else if(j != col)
-      {
-        cache[row_index_D[level]][j].LRU_age++;
-      }
-    }
+    touch_lru(cache, row_index_D[level], col);
   }
 }
 /* Calculates number of bits used for word, row, and tag and then uses that to
@@ -125,10 +370,17 @@ void setup_cache(CacheInfo i, CacheSetup* s)
   int tag_bits, row_bits, word_bits, byte_bits;
   s->num_rows = i.num_blocks/i.associativity;
   s->num_cols = i.associativity;
+  s->index = i.index;
+  if(i.index == Index_PRIME)
+  {
+    while(s->num_rows > 2 && !is_prime(s->num_rows))
+      s->num_rows--;
+  }
   /* Number of bits for each part of the address */
 	byte_bits = 2;
 	word_bits = power_of_two(i.words_per_block);
-	row_bits = power_of_two(s->num_rows);
+	for(row_bits = 0; (1 << row_bits) < s->num_rows; row_bits++)
+		;
 	tag_bits = 32 - byte_bits - word_bits - row_bits;
   /* Calculate shift and mask  */
 	s->word_shift = byte_bits;
@@ -137,108 +389,751 @@ void setup_cache(CacheInfo i, CacheSetup* s)
 	s->word_mask = (1 << word_bits) - 1;
 	s->row_mask = (1 << row_bits) - 1;
 	s->tag_mask = (1 << tag_bits) - 1;
+	s->row_bits = row_bits;
+	/* Hashed sets don't give the block number back, so the tag holds all of it */
+	if(i.index != Index_PLAIN)
+	{
+		s->tag_shift = s->row_shift;
+		s->tag_mask = (1 << (32 - s->row_shift)) - 1;
+	}
+}
+/* The set way goes in for a block of a skewed cache */
+static int skew_row(const CacheSetup* s, unsigned long block, int way)
+{
+  if(s->row_bits == 0)
+    return 0;
+  return (block * (0x9E3779B97F4A7C15UL * (2 * way + 1))) >> (64 - s->row_bits);
+}
+static int hashed_row(const CacheSetup* s, unsigned long block)
+{
+  int row = 0;
+  switch(s->index)
+  {
+    case Index_XOR:
+      for(; block != 0 && s->row_bits != 0; block >>= s->row_bits)
+        row ^= block & s->row_mask;
+      return row;
+    case Index_MOD:
+    case Index_PRIME:
+      return block % s->num_rows;
+    default:
+      return 0;
+  }
+}
+/* Picks the row an address goes in. Plain indexing stays a shift and a mask.
+  A skewed cache is only looked at through the one set skewed_access()
+  gathers, so that is row 0. */
+static inline int set_row(const CacheSetup* s, addr_t address)
+{
+  if(s->index == Index_PLAIN)
+    return (address >> s->row_shift) & s->row_mask;
+  return hashed_row(s, address >> s->row_shift);
+}
+/* Rebuilds the block number of a block from its tag and row */
+static inline unsigned long stored_block(const CacheSetup* s, unsigned int tag, int row)
+{
+  if(s->index != Index_PLAIN)
+    return tag;
+  return ((unsigned long)tag << (s->tag_shift - s->row_shift)) | row;
+}
+
+/* Works out how much arena space a cache needs: the blocks, then the packed
+  LRU ranks with 3 bytes of slack so lru_rank() can always read 4 bytes, then
+  the prefetched bitmap if the level has a prefetcher, the sector bits if
+  it is sectored and the last-use stamps if it is skewed */
+static size_t array_bytes(CacheArray* c, CacheSetup* s, int with_prefetch, int with_sectors)
+{
+  size_t blocks = (size_t)s->num_rows * s->num_cols;
+  c->num_cols = s->num_cols;
+  c->lru_bits = 0;
+  while((1 << c->lru_bits) < s->num_cols)
+    c->lru_bits++;
+  c->lru_mask = (1u << c->lru_bits) - 1;
+  c->lru_bytes = (s->num_cols * c->lru_bits + 7) / 8;
+  return blocks * sizeof(CacheBlock) + (size_t)s->num_rows * c->lru_bytes + 3 +
+    (with_prefetch ? (blocks + 7) / 8 : 0) +
+    (with_sectors ? blocks * sizeof(unsigned int) + sizeof(unsigned int) : 0) +
+    (s->index == Index_SKEW ? (blocks + 1) * sizeof(unsigned long) : 0);
+}
+/* Points a cache at its slice of the arena and sets the initial LRU ranks */
+static char* place_array(CacheArray* c, CacheSetup* s, int with_prefetch, int with_sectors, char* p)
+{
+  size_t blocks = (size_t)s->num_rows * s->num_cols;
+  int x, y;
+  c->blocks = (CacheBlock*)p;
+  p += blocks * sizeof(CacheBlock);
+  c->lru = (unsigned char*)p;
+  p += (size_t)s->num_rows * c->lru_bytes + 3;
+  c->prefetched = NULL;
+  if(with_prefetch)
+  {
+    c->prefetched = (unsigned char*)p;
+    p += (blocks + 7) / 8;
+  }
+  c->sectors = NULL;
+  if(with_sectors)
+  {
+    p += -(unsigned long)p & (sizeof(unsigned int) - 1);
+    c->sectors = (unsigned int*)p;
+    p += blocks * sizeof(unsigned int);
+  }
+  c->stamps = NULL;
+  if(s->index == Index_SKEW)
+  {
+    p += -(unsigned long)p & (sizeof(unsigned long) - 1);
+    c->stamps = (unsigned long*)p;
+    p += blocks * sizeof(unsigned long);
+  }
+  if(c->lru_bits != 0)
+  {
+    for(x = 0; x < s->num_rows; x++)
+      for(y = 0; y < s->num_cols; y++)
+        set_lru_rank(c, x, y, y);
+  }
+  /* keep the next cache's blocks aligned */
+  return p + (-(unsigned long)p & (sizeof(CacheBlock) - 1));
 }
 
 void setup_caches()
 {
+  CacheArray* arrays[4] = { &icache, &dcache, &dcache2, &dcache3 };
+  CacheSetup* setups[4] = { &icache_setup, &dcache_setup[0], &dcache_setup[1], &dcache_setup[2] };
+  int enabled[4], has_prefetcher[4] = { 0 };
+  size_t bytes = 0, block_bytes = 0;
+  char* p;
+  int x;
+
 	/* Setting up my caches here! */
 	setup_cache(icache_info, &icache_setup);
-
-  /* Allocate memory for i-cache array */
-  icache = calloc(sizeof(void*), icache_setup.num_rows);
-  int x, y;
-  for (x = 0; x < icache_setup.num_rows; x++)
+  enabled[0] = 1;
+  num_dlevels = 0;
+  for(x = 0; x < 3; x++)
   {
-    icache[x] = calloc(sizeof(CacheBlock), icache_setup.num_cols);
-  }
-  /* initialize all the cache blocks in the icache */
-  //printf("numrows: %d and numcols: %d\n", icache_setup.num_rows, icache_setup.num_cols);
-  for (x = 0; x < icache_setup.num_rows; x++) {
-    for(y = 0; y < icache_setup.num_cols; y++) {
-      icache[x][y].valid_bit = 0;
-      icache[x][y].LRU_age = 0;
+    enabled[x + 1] = dcache_info[x].num_blocks != 0 && (x == 0 || enabled[x]);
+    num_dlevels += enabled[x + 1];
+    if(enabled[x + 1])
+    {
+      setup_cache(dcache_info[x], &dcache_setup[x]);
+      has_prefetcher[x + 1] = prefetch_info[x].kind != Prefetch_NONE;
+      if(victim_caches[x].info.kind != Victim_NONE)
+        victim_init(&victim_caches[x], &victim_caches[x].info);
+      if(write_buffers[x].info.entries != 0)
+        write_buffer_init(&write_buffers[x], &write_buffers[x].info);
+      if(partitions[x].kind != Partition_NONE)
+        partition_init(&partitions[x], dcache_setup[x].num_rows, dcache_setup[x].num_cols);
+      if(has_prefetcher[x + 1])
+      {
+        prefetcher_init(&prefetchers[x], &prefetch_info[x]);
+        set_snapshot[x] = malloc(sizeof(CacheBlock) * dcache_setup[x].num_cols);
+      }
     }
   }
-  if(dcache_info[0].num_blocks != 0)
+
+  /* Every cache's metadata goes in one arena */
+  for(x = 0; x < 4; x++)
   {
-    setup_cache(dcache_info[0], &dcache_setup[0]);
-    /* Allocate memory for d-cache array */
-    dcache = calloc(sizeof(void*), dcache_setup[0].num_rows);
-    for (x = 0; x < dcache_setup[0].num_rows; x++)
+    if(enabled[x])
     {
-      dcache[x] = calloc(sizeof(CacheBlock), dcache_setup[0].num_cols);
-    }
-    /* initialize all the cache blocks in the dcache */
-    //printf("numrows: %d and numcols: %d\n", icache_setup.num_rows, icache_setup.num_cols);
-    for (x = 0; x < dcache_setup[0].num_rows; x++) {
-      for(y = 0; y < dcache_setup[0].num_cols; y++) {
-        dcache[x][y].valid_bit = 0;
-        dcache[x][y].dirty_bit = 0;
-        dcache[x][y].LRU_age = 0;
-      }
+      bytes += array_bytes(arrays[x], setups[x], has_prefetcher[x], x > 0 && sector_words[x - 1] != 0) + sizeof(CacheBlock);
+      block_bytes += (size_t)setups[x]->num_rows * setups[x]->num_cols * sizeof(CacheBlock);
     }
-    if(dcache_info[1].num_blocks != 0)
+  }
+  for(x = 1; x < num_cores; x++)
+  {
+    bytes += array_bytes(&cores[x].icache, &icache_setup, 0, 0) + sizeof(CacheBlock);
+    bytes += array_bytes(&cores[x].dcache, &dcache_setup[0], 0, 0) + sizeof(CacheBlock);
+    block_bytes += ((size_t)icache_setup.num_rows * icache_setup.num_cols +
+      (size_t)dcache_setup[0].num_rows * dcache_setup[0].num_cols) * sizeof(CacheBlock);
+  }
+  p = arena_alloc(bytes, huge_pages);
+  if(p == NULL)
+  {
+    fprintf(stderr, "Could not allocate %lu bytes of cache metadata.\n", (unsigned long)bytes);
+    exit(1);
+  }
+  for(x = 0; x < 4; x++)
+  {
+    if(enabled[x])
+      p = place_array(arrays[x], setups[x], has_prefetcher[x], x > 0 && sector_words[x - 1] != 0, p);
+  }
+  for(x = 1; x < num_cores; x++)
+  {
+    p = place_array(&cores[x].icache, &icache_setup, 0, 0, p);
+    p = place_array(&cores[x].dcache, &dcache_setup[0], 0, 0, p);
+  }
+  metadata_block_bytes = block_bytes;
+  for(x = 0; x < 4 && hot_k != 0; x++)
+  {
+    int t;
+    for(t = 0; t < 4 && enabled[x]; t++)
     {
-      setup_cache(dcache_info[1], &dcache_setup[1]);
-      /* Allocate memory for d-cache array */
-      dcache2 = calloc(sizeof(void*), dcache_setup[1].num_rows);
-      for (x = 0; x < dcache_setup[1].num_rows; x++)
-      {
-        dcache2[x] = calloc(sizeof(CacheBlock), dcache_setup[1].num_cols);
-      }
-      /* initialize all the cache blocks in the dcache */
-      //printf("numrows: %d and numcols: %d\n", icache_setup.num_rows, icache_setup.num_cols);
-      for (x = 0; x < dcache_setup[1].num_rows; x++) {
-        for(y = 0; y < dcache_setup[1].num_cols; y++) {
-          dcache2[x][y].valid_bit = 0;
-          dcache2[x][y].dirty_bit = 0;
-          dcache2[x][y].LRU_age = 0;
-        }
-      }
+      if(x > 0 || t < Hot_BLOCK_WRITEBACKS)
+        hot_init(&hot_trackers[x][t], hot_k);
     }
-    if(dcache_info[2].num_blocks != 0)
+  }
+  watch_misses = hot_k != 0 || set_histograms;
+  for(x = 0; x < 4 && set_histograms; x++)
+  {
+    if(enabled[x])
+      set_misses[x] = calloc(setups[x]->num_rows, sizeof(long long));
+  }
+  for(x = 0; x < 4; x++)
+  {
+    if(enabled[x] && setups[x]->index == Index_SKEW)
     {
-      setup_cache(dcache_info[2], &dcache_setup[2]);
-      /* Allocate memory for d-cache array */
-      dcache3 = calloc(sizeof(void*), dcache_setup[2].num_rows);
-      for (x = 0; x < dcache_setup[2].num_rows; x++)
-      {
-        dcache3[x] = calloc(sizeof(CacheBlock), dcache_setup[2].num_cols);
-      }
-      /* initialize all the cache blocks in the dcache */
-      //printf("numrows: %d and numcols: %d\n", icache_setup.num_rows, icache_setup.num_cols);
-      for (x = 0; x < dcache_setup[2].num_rows; x++) {
-        for(y = 0; y < dcache_setup[2].num_cols; y++) {
-          dcache3[x][y].valid_bit = 0;
-          dcache3[x][y].dirty_bit = 0;
-          dcache3[x][y].LRU_age = 0;
-        }
-      }
+      CacheSetup one_set = *setups[x];
+      one_set.num_rows = 1;
+      one_set.index = Index_PLAIN;
+      p = malloc(array_bytes(&skew_sets[x], &one_set, 0, 0));
+      place_array(&skew_sets[x], &one_set, 0, 0, p);
     }
   }
+  /* Other cores' coherence traffic changes the L1s behind their backs */
+  memset(mru_block, 0, sizeof(mru_block));
+  fast_path[0] = num_cores == 1 && icache_setup.index != Index_SKEW;
+  for(x = 0; x < 3; x++)
+  {
+    fast_path[x + 1] = enabled[x + 1] && num_cores == 1 && dcache_setup[x].index != Index_SKEW &&
+      !has_prefetcher[x + 1] && write_buffers[x].info.entries == 0 && sector_words[x] == 0 &&
+      partitions[x].kind == Partition_NONE;
+  }
+  if(timing_enabled)
+  {
+    timing_setup(num_dlevels);
+  }
+  if(tlb_enabled)
+  {
+    tlb_setup();
+  }
+
     /* Intializes random number generator */
     srand(1000);
     //srand((unsigned int)time(NULL));
+  if(check_accesses)
+    ref_init(&reference, &icache_info, dcache_info, num_dlevels);
 	/* This call to dump_cache_info is just to show some debugging information
 	and you may remove it. */
 	//dump_cache_info();
 }
+/* Reports how much host memory the cache metadata takes */
+void print_memory_use()
+{
+  fprintf(stderr, "Cache metadata: %.1f KB (%.1f KB blocks, %.1f KB replacement state) on %s.\n",
+    arena_size() / 1024.0, metadata_block_bytes / 1024.0,
+    (arena_size() - metadata_block_bytes) / 1024.0, arena_backing());
+}
+/* Sets the cache parameters without going through the command line, for
+  the benchmark driver. levels is how many D-cache levels are enabled. */
+void configure_caches(CacheInfo icache, CacheInfo* dcaches, int levels)
+{
+  int i;
+  icache_info = icache;
+  for(i = 0; i < 3; i++)
+  {
+    if(i < levels)
+      dcache_info[i] = dcaches[i];
+    else
+      memset(&dcache_info[i], 0, sizeof(CacheInfo));
+  }
+}
+/* Copies out the raw counters; dstats must have room for 3 levels */
+void get_cache_stats(CacheStats* istats, CacheStats* dstats)
+{
+  *istats = icache_stats;
+  memcpy(dstats, dcache_stats, sizeof(dcache_stats));
+}
+/* Passes a block read on to the next D-cache level, if there is one */
+static void read_next_level(addr_t address, int level)
+{
+  PROF_SAVE();
+  if(level == demand_level && !prefetching[level])
+  {
+    demand_level = level + 1;
+    if(dram_enabled && demand_level == num_dlevels)
+      memory_latency = dram_access(memory_clock(), address, 0, dcache_info[level].words_per_block) - memory_clock();
+  }
+  else if(dram_enabled && level == num_dlevels - 1)
+    dram_access(memory_clock(), address, 0, dcache_info[level].words_per_block);
+  if(level == 0 && dcache_info[1].num_blocks != 0) {
+    accessD_Read(address, 1, &dcache2);
+  }
+  if(level == 1 && dcache_info[2].num_blocks != 0) {
+    accessD_Read(address, 2, &dcache3);
+  }
+  PROF_RESTORE();
+}
+/* Passes a write of words on to the next D-cache level, if there is one */
+static void write_next_level(addr_t address, int level, int words)
+{
+  PROF_SAVE();
+  if(dram_enabled && level == num_dlevels - 1)
+    dram_access(memory_clock(), address, 1, words);
+  if(level == 0 && dcache_info[1].num_blocks != 0) {
+    accessD_Write(address, 1, &dcache2);
+  }
+  if(level == 1 && dcache_info[2].num_blocks != 0) {
+    accessD_Write(address, 2, &dcache3);
+  }
+  PROF_RESTORE();
+}
+/* Hands the block about to be replaced at (row, col) to the level's victim
+  cache, if it has one */
+static void victim_cache_evict(int level, CacheArray* cache, int row, int col)
+{
+  VictimCache* v = &victim_caches[level];
+  if(v->info.kind != Victim_VICTIM)
+    return;
+  victim_insert(v, stored_block(&dcache_setup[level], block_tag(cache, row, col), row));
+}
+/* Called on a miss that allocates, before anything is replaced. col is the
+  way being replaced, or -1 if it is empty. Returns whether the level's
+  victim or miss cache has the block, so it needn't be read from below. */
+static int victim_cache_miss(int level, addr_t address, CacheArray* cache, int row, int col)
+{
+  VictimCache* v = &victim_caches[level];
+  unsigned long block = address >> dcache_setup[level].row_shift;
+  int hit;
+  if(v->info.kind == Victim_NONE)
+    return 0;
+  hit = victim_probe(v, block);
+  if(col >= 0)
+    victim_cache_evict(level, cache, row, col);
+  if(!hit && v->info.kind == Victim_MISS)
+    victim_insert(v, block);
+  return hit;
+}
+/* Sends a buffered entry to the next level as one write of all its words */
+static void drain_entry(int level, WriteBufferEntry* e)
+{
+  WriteBuffer* b = &write_buffers[level];
+  addr_t address = (addr_t)(e->block - 1) << dcache_setup[level].row_shift;
+  int words = __builtin_popcountl(e->words);
+
+  write_buffer_remove(b, e);
+  b->stats.drains++;
+  b->stats.words_drained += words;
+  dcache_stats[level].words_write_mem += words;
+  write_next_level(address, level, words);
+}
+/* Sends a store on from a write-through level, through its write buffer if
+  it has one */
+static void write_through(addr_t address, int level)
+{
+  WriteBuffer* b = &write_buffers[level];
+  unsigned long block = address >> dcache_setup[level].row_shift;
+  int word = (address >> dcache_setup[level].word_shift) & dcache_setup[level].word_mask;
+
+  if(b->info.entries == 0)
+  {
+    dcache_stats[level].words_write_mem++;
+    write_next_level(address, level, 1);
+    return;
+  }
+  if(write_buffer_add(b, block, word) != 0)
+  {
+    b->stats.full_stalls++;
+    drain_entry(level, write_buffer_oldest(b));
+    write_buffer_add(b, block, word);
+  }
+  while(b->used > b->info.high_water)
+    drain_entry(level, write_buffer_oldest(b));
+}
+/* Called on every read of a level with a write buffer: counts reads of
+  blocks still in the buffer, and drains an entry under the eager policy */
+static void write_buffer_read(int level, addr_t address)
+{
+  WriteBuffer* b = &write_buffers[level];
+  if(write_buffer_find(b, address >> dcache_setup[level].row_shift) != NULL)
+    b->stats.raw_matches++;
+  if(b->info.drain == Drain_EAGER && b->used != 0)
+    drain_entry(level, write_buffer_oldest(b));
+}
+/* Drains every write buffer, top level first, at the end of a run */
+static void drain_write_buffers()
+{
+  int level;
+  for(level = 0; level < 3; level++)
+  {
+    while(write_buffers[level].used != 0)
+      drain_entry(level, write_buffer_oldest(&write_buffers[level]));
+  }
+}
+/* Records a miss for --hot and --set-misses; which is 0 for the I-cache and
+  level + 1 for a D-cache level */
+static void note_miss(int which, addr_t address)
+{
+  CacheSetup* s = which == 0 ? &icache_setup : &dcache_setup[which - 1];
+  if(hot_k)
+  {
+    hot_add(&hot_trackers[which][Hot_BLOCK_MISSES], address >> s->row_shift);
+    hot_add(&hot_trackers[which][Hot_REGION_MISSES], address >> hot_region_bits);
+  }
+  if(set_misses[which] != NULL)
+    set_misses[which][which == 0 ? row_index_I : row_index_D[which - 1]]++;
+}
+static void hot_writeback(int level, unsigned long block)
+{
+  hot_add(&hot_trackers[level + 1][Hot_BLOCK_WRITEBACKS], block);
+  hot_add(&hot_trackers[level + 1][Hot_REGION_WRITEBACKS], (block << dcache_setup[level].row_shift) >> hot_region_bits);
+}
+static long long icache_misses()
+{
+  return icache_stats.compulsory_reads + icache_stats.conflict_reads + icache_stats.capacity_reads;
+}
+/* Reads a missing block in from the next level, unless the victim or miss
+  cache supplied it. A write still buffered for the block goes first. */
+static void fetch_block(addr_t address, int level, int supplied)
+{
+  WriteBufferEntry* e;
+  if(supplied)
+  {
+    victim_caches[level].stats.words_saved += dcache_info[level].words_per_block;
+    return;
+  }
+  if(write_buffers[level].used != 0 && (e = write_buffer_find(&write_buffers[level], address >> dcache_setup[level].row_shift)) != NULL)
+  {
+    write_buffers[level].stats.raw_drains++;
+    drain_entry(level, e);
+  }
+  if(sector_words[level] != 0)
+  {
+    /* sector_update() fetches just the sector that is needed */
+    sector_stats[level].block_words_read += dcache_info[level].words_per_block;
+    return;
+  }
+  dcache_stats[level].words_read_mem += dcache_info[level].words_per_block;
+  read_next_level(address, level);
+}
+/* Writes back the dirty block at (row, col) that is being replaced, to
+  where that block lives below. A sectored level only writes back its dirty
+  sectors. */
+static void write_back(int level, CacheArray* cache, int row, int col)
+{
+  int words = dcache_info[level].words_per_block, charged = words;
+  unsigned long block = stored_block(&dcache_setup[level], block_tag(cache, row, col), row);
+  addr_t address = (addr_t)block << dcache_setup[level].row_shift;
+  if(hot_k)
+    hot_writeback(level, block);
+  if(cache->sectors != 0)
+  {
+    sector_stats[level].block_words_written += charged;
+    words = charged = __builtin_popcount(*block_sectors(cache, row, col) >> SECTOR_DIRTY_SHIFT) * sector_words[level];
+    sector_stats[level].words_written += words;
+  }
+  dcache_stats[level].words_write_mem += charged;
+  write_next_level(address, level, words);
+}
+/* Returns the metadata array for a D-cache level */
+static CacheArray* dcache_array(int level)
+{
+  return level == 0 ? &dcache : level == 1 ? &dcache2 : &dcache3;
+}
+/* Returns the way holding address in a D-cache level, or -1 if it misses.
+  Unlike the access functions this doesn't touch any state. */
+static int find_block_in(CacheArray* cache, int level, addr_t address)
+{
+  int row = set_row(&dcache_setup[level], address);
+  unsigned int tag = (address >> dcache_setup[level].tag_shift) & dcache_setup[level].tag_mask;
+  int col;
+  for(col = 0; col < dcache_setup[level].num_cols; col++)
+  {
+    if(!block_valid(cache, row, col))
+      break;
+    if(block_tag(cache, row, col) == tag)
+      return col;
+  }
+  return -1;
+}
+static int find_block(int level, addr_t address)
+{
+  return find_block_in(dcache_array(level), level, address);
+}
+/* Brings the sector an access touches into a sectored level once the block
+  is there (a new block starts with no sectors), and marks it dirty for a
+  write-back store. A sector a store fully overwrites isn't read. */
+static void sector_update(int level, CacheArray* cache, addr_t address, int is_write)
+{
+  int row = row_index_D[level], col = find_block_in(cache, level, address);
+  unsigned int* sectors;
+  unsigned int bit;
+
+  if(col < 0)
+    return;
+  sectors = block_sectors(cache, row, col);
+  bit = 1u << (word_index_D[level] / sector_words[level]);
+  if(!(*sectors & bit))
+  {
+    if(is_write && dcache_info[level].allocate_scheme == Allocate_NO_ALLOCATE && sector_words[level] > 1)
+      return;
+    if(*sectors != 0)
+      sector_stats[level].sector_misses++;
+    if(!is_write || sector_words[level] > 1)
+    {
+      dcache_stats[level].words_read_mem += sector_words[level];
+      sector_stats[level].words_read += sector_words[level];
+      read_next_level(address, level);
+    }
+    *sectors |= bit;
+  }
+  if(is_write && dcache_info[level].write_scheme == Write_WRITE_BACK)
+    *sectors |= bit << SECTOR_DIRTY_SHIFT;
+}
+/* Brings a prefetched block into a level through the normal read path.
+  The demand counters are put back afterwards so only the traffic shows up in
+  the level's statistics; the block is marked as prefetched, and whatever it
+  evicted is remembered so a later miss on it can be blamed on the prefetch. */
+static void prefetch_fill(int level, unsigned long block)
+{
+  CacheArray* cache = dcache_array(level);
+  CacheStats saved = dcache_stats[level];
+  addr_t address = (addr_t)block << dcache_setup[level].row_shift;
+  int row = set_row(&dcache_setup[level], address);
+  unsigned long victim;
+  int col;
+
+  if(find_block(level, address) >= 0)
+  {
+    prefetch_stats[level].redundant++;
+    return;
+  }
+  memcpy(set_snapshot[level], block_at(cache, row, 0), sizeof(CacheBlock) * dcache_setup[level].num_cols);
+
+  prefetching[level] = 1;
+  accessD_Read(address, level, cache);
+  prefetching[level] = 0;
+
+  prefetch_stats[level].filled++;
+  prefetch_stats[level].words_read_mem += dcache_stats[level].words_read_mem - saved.words_read_mem;
+  prefetch_stats[level].words_write_mem += dcache_stats[level].words_write_mem - saved.words_write_mem;
+  dcache_stats[level].num_reads = saved.num_reads;
+  dcache_stats[level].compulsory_reads = saved.compulsory_reads;
+  dcache_stats[level].conflict_reads = saved.conflict_reads;
+  dcache_stats[level].capacity_reads = saved.capacity_reads;
+
+  for(col = 0; col < dcache_setup[level].num_cols; col++)
+  {
+    if(*block_at(cache, row, col) != set_snapshot[level][col])
+    {
+      set_prefetched(cache, row, col, 1);
+      if(set_snapshot[level][col] & BLOCK_VALID)
+      {
+        victim = stored_block(&dcache_setup[level], set_snapshot[level][col] >> BLOCK_TAG_SHIFT, row);
+        pollution[level][victim % POLLUTION_SIZE] = victim + 1;
+      }
+      break;
+    }
+  }
+  prefetcher_filled(&prefetchers[level], block);
+}
+/* Returns the queue slot holding a prefetch of block, or -1 */
+static int find_pending(int level, unsigned long block)
+{
+  int i;
+  for(i = 0; i < prefetch_queued[level]; i++)
+  {
+    if(prefetch_queue[level][i].block == block)
+      return i;
+  }
+  return -1;
+}
+static void remove_pending(int level, int i)
+{
+  prefetch_queued[level]--;
+  memmove(&prefetch_queue[level][i], &prefetch_queue[level][i + 1], sizeof(PendingPrefetch) * (prefetch_queued[level] - i));
+}
+/* Runs before every demand access to a level with a prefetcher: fills the
+  prefetches that have arrived, scores the access against them, trains the
+  prefetcher on it and queues whatever it asks for */
+static void prefetch_demand(int level, addr_t address)
+{
+  CacheArray* cache = dcache_array(level);
+  unsigned long candidates[PREFETCH_MAX_DEGREE];
+  unsigned long block = address >> dcache_setup[level].row_shift;
+  unsigned long max_block = 0xFFFFFFFFUL >> dcache_setup[level].row_shift;
+  int row = set_row(&dcache_setup[level], address);
+  int col, i, n, prefetch_hit = 0;
+
+  prefetch_clock[level]++;
+  while(prefetch_queued[level] > 0 && prefetch_queue[level][0].due <= prefetch_clock[level])
+  {
+    unsigned long due_block = prefetch_queue[level][0].block;
+    remove_pending(level, 0);
+    prefetch_fill(level, due_block);
+  }
+
+  col = find_block(level, address);
+  if(col >= 0 && block_prefetched(cache, row, col))
+  {
+    prefetch_stats[level].useful++;
+    set_prefetched(cache, row, col, 0);
+    prefetch_hit = 1;
+  }
+  else if(col < 0)
+  {
+    i = find_pending(level, block);
+    if(i >= 0)
+    {
+      /* The demand miss fetches it instead */
+      prefetch_stats[level].late++;
+      remove_pending(level, i);
+    }
+    if(pollution[level][block % POLLUTION_SIZE] == block + 1)
+    {
+      prefetch_stats[level].polluting++;
+      pollution[level][block % POLLUTION_SIZE] = 0;
+    }
+  }
+
+  n = prefetcher_train(&prefetchers[level], block, col < 0, prefetch_hit, candidates);
+  for(i = 0; i < n; i++)
+  {
+    if(candidates[i] > max_block)
+      continue;
+    if(find_block(level, candidates[i] << dcache_setup[level].row_shift) >= 0 || find_pending(level, candidates[i]) >= 0)
+      prefetch_stats[level].redundant++;
+    else if(prefetch_queued[level] == PREFETCH_QUEUE)
+      prefetch_stats[level].dropped++;
+    else
+    {
+      prefetch_queue[level][prefetch_queued[level]].block = candidates[i];
+      prefetch_queue[level][prefetch_queued[level]].due = prefetch_clock[level] + prefetch_info[level].delay;
+      prefetch_queued[level]++;
+      prefetch_stats[level].issued++;
+    }
+  }
+}
+static long long level_misses(int level)
+{
+  CacheStats* s = &dcache_stats[level];
+  return s->compulsory_reads + s->conflict_reads + s->capacity_reads +
+    s->compulsory_writes + s->conflict_writes + s->capacity_writes;
+}
+/* Works out which partition class an access to a partitioned level belongs to
+  and feeds it to the shadow tags */
+static void partition_begin(int level, addr_t address)
+{
+  Partition* p = &partitions[level];
+  partition_cls[level] = partition_class(p, address, current_core);
+  partition_misses[level] = level_misses(level);
+  if(!prefetching[level])
+    partition_access(p, partition_cls[level], set_row(&dcache_setup[level], address), address >> dcache_setup[level].row_shift);
+}
+/* Gives the block the access left behind to its class and counts the access */
+static void partition_end(int level, CacheArray* cache, addr_t address)
+{
+  Partition* p = &partitions[level];
+  int col = find_block_in(cache, level, address), cls = partition_cls[level];
+  if(col >= 0)
+    p->owners[(size_t)row_index_D[level] * p->ways + col] = cls;
+  if(!prefetching[level])
+  {
+    p->stats[cls].accesses++;
+    p->stats[cls].misses += level_misses(level) - partition_misses[level];
+  }
+}
+/* Runs one access on a skewed-associative cache (level -1 is the I-cache).
+  The ways a block can go in sit in different rows, so they are gathered into
+  a one-set scratch array, valid ways first and ranked by when they were last
+  used, the normal access runs on that, and the ways are put back. */
+static void skewed_access(AccessType type, addr_t address, int level)
+{
+  CacheSetup* s = level < 0 ? &icache_setup : &dcache_setup[level];
+  CacheArray* cache = level < 0 ? &icache : dcache_array(level);
+  CacheArray* set = &skew_sets[level + 1];
+  CacheArray saved_icache;
+  unsigned long block = address >> s->row_shift;
+  unsigned long* stamp[MAX_SKEW_WAYS];
+  int rows[MAX_SKEW_WAYS], ways[MAX_SKEW_WAYS];
+  int w, i, j, rank, valid = 0;
+
+  for(w = 0; w < s->num_cols; w++)
+  {
+    rows[w] = skew_row(s, block, w);
+    stamp[w] = &cache->stamps[(unsigned long)rows[w] * s->num_cols + w];
+    if(block_valid(cache, rows[w], w))
+      ways[valid++] = w;
+  }
+  for(w = 0, i = valid; w < s->num_cols; w++)
+  {
+    if(!block_valid(cache, rows[w], w))
+      ways[i++] = w;
+  }
+  for(i = 0; i < s->num_cols; i++)
+  {
+    *block_at(set, 0, i) = *block_at(cache, rows[ways[i]], ways[i]);
+    rank = i;
+    if(i < valid)
+    {
+      for(j = 0, rank = 0; j < valid; j++)
+        rank += *stamp[ways[j]] > *stamp[ways[i]];
+    }
+    set_lru_rank(set, 0, i, rank);
+  }
+
+  if(level < 0)
+  {
+    saved_icache = icache;
+    icache = *set;
+    accessI(address);
+    icache = saved_icache;
+  }
+  else if(type == Access_D_READ)
+    accessD_Read(address, level, set);
+  else
+    accessD_Write(address, level, set);
+
+  for(i = 0; i < s->num_cols; i++)
+  {
+    *block_at(cache, rows[ways[i]], ways[i]) = *block_at(set, 0, i);
+    if(block_valid(set, 0, i) && block_tag(set, 0, i) == block)
+      *stamp[ways[i]] = ++skew_clock;
+  }
+}
+/* The way random replacement throws out. With --check the draw goes to the
+  reference model too, so both pick the same way. */
+static int random_way(int ways)
+{
+  int draw = rand();
+  if(check_accesses)
+    ref_draw(&reference, draw);
+  return draw % ways;
+}
+
 void accessI(addr_t address){
+  if(icache_setup.index == Index_SKEW && icache.blocks != skew_sets[0].blocks)
+  {
+    skewed_access(Access_I_FETCH, address, -1);
+    return;
+  }
+  if(mru_block[0] == (address >> icache_setup.row_shift) + 1)
+  {
+    /* hit on the MRU way */
+    row_index_I = mru_row[0];
+    col_index_I = mru_col[0];
+    icache_stats.num_reads++;
+    PROF_HIT(PROF_ICACHE);
+    return;
+  }
+  if(watch_misses)
+    hot_misses[0] = icache_misses();
 	/* Picking apart the address */
 	word_index_I = (address >> icache_setup.word_shift) & icache_setup.word_mask;
-	row_index_I = (address >> icache_setup.row_shift) & icache_setup.row_mask;
+	row_index_I = set_row(&icache_setup, address);
 	tag_I = (address >> icache_setup.tag_shift) & icache_setup.tag_mask;
   //printf("row index: %d\ntag_I: %d\n", row_index_I, tag_I);
 
+	PROF_ENTER(Prof_LOOKUP, PROF_ICACHE);
 	icache_stats.num_reads++;
   col_index_I = 0;
   while(1)
   {
-    if(icache[row_index_I][col_index_I].valid_bit == 1)
+    if(block_valid(&icache, row_index_I, col_index_I))
     {
-      if(icache[row_index_I][col_index_I].tag == tag_I)
+      if(block_tag(&icache, row_index_I, col_index_I) == tag_I)
       {
         /*hit*/
+        PROF_HIT(PROF_ICACHE);
+        PROF_ENTER(Prof_REPLACEMENT, PROF_ICACHE);
         updateAge(col_index_I);
         break;
       }
@@ -246,35 +1141,41 @@ void accessI(addr_t address){
     	{
         /*conflict miss*/
     		icache_stats.conflict_reads++;
+    		PROF_MISS(PROF_ICACHE);
+    		PROF_ENTER(Prof_FILL, PROF_ICACHE);
     		icache_stats.words_read_mem += icache_info.words_per_block;
-    		icache[row_index_I][col_index_I].tag = tag_I;
+    		set_tag(&icache, row_index_I, col_index_I, tag_I);
         break;
     	}
       else if(col_index_I == icache_setup.num_cols-1)
       {
         /* Reached the end of the row and need to kick out a block*/
         icache_stats.capacity_reads++;
+        PROF_MISS(PROF_ICACHE);
         icache_stats.words_read_mem += icache_info.words_per_block;
+        PROF_ENTER(Prof_REPLACEMENT, PROF_ICACHE);
         if(icache_info.replacement == Replacement_RANDOM)
         {
           /* Randomly replace a block in the row */
-          icache[row_index_I][rand() % icache_setup.num_cols].tag = tag_I;
+          col_index_I = random_way(icache_setup.num_cols);
+          set_tag(&icache, row_index_I, col_index_I, tag_I);
         }
         else
         {
           int j;
-          int oldest = icache[row_index_I][0].LRU_age;
+          unsigned int oldest = lru_rank(&icache, row_index_I, 0);
           int oldest_index = 0;
           /* Find oldest cache block */
           for(j = 1; j < icache_setup.num_cols; j++)
           {
-            if(icache[row_index_I][j].LRU_age > oldest) {
-              oldest = icache[row_index_I][j].LRU_age;
+            if(lru_rank(&icache, row_index_I, j) > oldest) {
+              oldest = lru_rank(&icache, row_index_I, j);
               oldest_index = j;
             }
           }
           /* Replace the LRU cache block with new data */
-          icache[row_index_I][oldest_index].tag = tag_I;
+          col_index_I = oldest_index;
+          set_tag(&icache, row_index_I, oldest_index, tag_I);
           updateAge(oldest_index);
         }
         break;
@@ -289,115 +1190,135 @@ void accessI(addr_t address){
   	{
       /* Compulsory miss - Cache slot used to be empty */
   		icache_stats.compulsory_reads++;
+  		PROF_MISS(PROF_ICACHE);
+  		PROF_ENTER(Prof_FILL, PROF_ICACHE);
   		icache_stats.words_read_mem += icache_info.words_per_block;
-  		icache[row_index_I][col_index_I].valid_bit = 1;
-  		icache[row_index_I][col_index_I].tag = tag_I;
+  		set_valid(&icache, row_index_I, col_index_I);
+  		set_tag(&icache, row_index_I, col_index_I, tag_I);
       updateAge(col_index_I);
       break;
   	}
 
   }
+  if(fast_path[0])
+    note_mru(0, address >> icache_setup.row_shift, row_index_I, col_index_I);
+  if(watch_misses && icache_misses() != hot_misses[0])
+    note_miss(0, address);
 }
-void accessD_Read(addr_t address, int level, CacheBlock** cache){
+void accessD_Read(addr_t address, int level, CacheArray* cache){
+  int supplied;
+  if(dcache_setup[level].index == Index_SKEW && cache != &skew_sets[level + 1])
+  {
+    skewed_access(Access_D_READ, address, level);
+    return;
+  }
+  if(mru_block[level + 1] == (address >> dcache_setup[level].row_shift) + 1)
+  {
+    /* hit on the MRU way */
+    row_index_D[level] = mru_row[level + 1];
+    col_index_D[level] = mru_col[level + 1];
+    dcache_stats[level].num_reads++;
+    PROF_HIT(PROF_DCACHE(level));
+    return;
+  }
+  if(prefetch_info[level].kind != Prefetch_NONE && !prefetching[level])
+    prefetch_demand(level, address);
+  if(write_buffers[level].info.entries != 0)
+    write_buffer_read(level, address);
+  if(partitions[level].kind != Partition_NONE)
+    partition_begin(level, address);
+  if(watch_misses)
+    hot_misses[level + 1] = level_misses(level);
 	/* Picking apart the address */
 	word_index_D[level] = (address >> dcache_setup[level].word_shift) & dcache_setup[level].word_mask;
-	row_index_D[level] = (address >> dcache_setup[level].row_shift) & dcache_setup[level].row_mask;
+	row_index_D[level] = set_row(&dcache_setup[level], address);
 	tag_D[level] = (address >> dcache_setup[level].tag_shift) & dcache_setup[level].tag_mask;
   //printf("row index: %d\ntag_I: %d\n", row_index_I, tag_I);
 
+	PROF_ENTER(Prof_LOOKUP, PROF_DCACHE(level));
 	dcache_stats[level].num_reads++;
   col_index_D[level] = 0;
   while(1)
   {
-    if(cache[row_index_D[level]][col_index_D[level]].valid_bit == 1)
+    if(block_valid(cache, row_index_D[level], col_index_D[level]))
     {
-      if(cache[row_index_D[level]][col_index_D[level]].tag == tag_D[level])
+      if(block_tag(cache, row_index_D[level], col_index_D[level]) == tag_D[level])
       {
         /*hit*/
+        PROF_HIT(PROF_DCACHE(level));
+        PROF_ENTER(Prof_REPLACEMENT, PROF_DCACHE(level));
         updateAgeD(col_index_D[level], level, cache);
         break;
       }
       else if(dcache_info[level].associativity == 1)
     	{
         dcache_stats[level].conflict_reads++;
-        if(cache[row_index_D[level]][col_index_D[level]].dirty_bit == 1)
+        PROF_MISS(PROF_DCACHE(level));
+        supplied = victim_cache_miss(level, address, cache, row_index_D[level], col_index_D[level]);
+        if(block_dirty(cache, row_index_D[level], col_index_D[level]))
         {
           /* write previous data in cache block to memory */
-          dcache_stats[level].words_write_mem += dcache_info[level].words_per_block;
-          if(level == 0 && dcache_info[1].num_blocks != 0) {
-            accessD_Write(address, 1, dcache2);
-          }
-          if(level == 1 && dcache_info[2].num_blocks != 0) {
-            accessD_Write(address, 2, dcache3);
-          }
-        }
-    		dcache_stats[level].words_read_mem += dcache_info[level].words_per_block;
-    		cache[row_index_D[level]][col_index_D[level]].tag = tag_D[level];
-        cache[row_index_D[level]][col_index_D[level]].dirty_bit = 0;
-        if(level == 0 && dcache_info[1].num_blocks != 0) {
-          accessD_Read(address, 1, dcache2);
-        }
-        if(level == 1 && dcache_info[2].num_blocks != 0) {
-          accessD_Read(address, 2, dcache3);
+          PROF_ENTER(Prof_WRITEBACK, PROF_DCACHE(level));
+          write_back(level, cache, row_index_D[level], col_index_D[level]);
         }
+    		PROF_ENTER(Prof_FILL, PROF_DCACHE(level));
+    		set_tag(cache, row_index_D[level], col_index_D[level], tag_D[level]);
+        set_dirty(cache, row_index_D[level], col_index_D[level], 0);
+        fetch_block(address, level, supplied);
         break;
     	}
       else if(col_index_D[level] == dcache_setup[level].num_cols-1)
       {
         /* Reached the end of the row and need to kick out a block*/
         dcache_stats[level].capacity_reads++;
-        dcache_stats[level].words_read_mem += dcache_info[level].words_per_block;
+        PROF_MISS(PROF_DCACHE(level));
+        PROF_ENTER(Prof_REPLACEMENT, PROF_DCACHE(level));
         if(dcache_info[level].replacement == Replacement_RANDOM)
         {
-          if(cache[row_index_D[level]][col_index_D[level]].dirty_bit == 1)
+          /* Pick the victim first: its own dirty bit decides the writeback */
+          col_index_D[level] = partitions[level].kind != Partition_NONE ?
+            partition_victim(&partitions[level], cache, row_index_D[level], partition_cls[level], 0) :
+            random_way(dcache_setup[level].num_cols);
+          supplied = victim_cache_miss(level, address, cache, row_index_D[level], col_index_D[level]);
+          if(block_dirty(cache, row_index_D[level], col_index_D[level]))
           {
             /* write previous data in cache block to memory */
-            dcache_stats[level].words_write_mem += dcache_info[level].words_per_block;
-            if(level == 0 && dcache_info[1].num_blocks != 0) {
-              accessD_Write(address, 1, dcache2);
-            }
-            if(level == 1 && dcache_info[2].num_blocks != 0) {
-              accessD_Write(address, 2, dcache3);
-            }
+            PROF_ENTER(Prof_WRITEBACK, PROF_DCACHE(level));
+            write_back(level, cache, row_index_D[level], col_index_D[level]);
           }
-          col_index_D[level] = rand() % dcache_setup[level].num_cols;
-          cache[row_index_D[level]][col_index_D[level]].tag = tag_D[level];
-          cache[row_index_D[level]][col_index_D[level]].dirty_bit = 0;
+          PROF_ENTER(Prof_FILL, PROF_DCACHE(level));
+          set_tag(cache, row_index_D[level], col_index_D[level], tag_D[level]);
+          set_dirty(cache, row_index_D[level], col_index_D[level], 0);
         }
         else
         {
           int j;
-          int oldest = cache[row_index_D[level]][level].LRU_age;
+          unsigned int oldest = lru_rank(cache, row_index_D[level], 0);
           int oldest_index = 0;
           /* Find oldest block to replace */
           for(j = 1; j < dcache_setup[level].num_cols; j++)
           {
-            if(cache[row_index_D[level]][j].LRU_age > oldest) {
-              oldest = dcache[row_index_D[level]][j].LRU_age;
+            if(lru_rank(cache, row_index_D[level], j) > oldest) {
+              oldest = lru_rank(cache, row_index_D[level], j);
               oldest_index = j;
             }
           }
-          if(cache[row_index_D[level]][oldest_index].dirty_bit == 1)
+          if(partitions[level].kind != Partition_NONE)
+            oldest_index = partition_victim(&partitions[level], cache, row_index_D[level], partition_cls[level], 1);
+          col_index_D[level] = oldest_index;
+          supplied = victim_cache_miss(level, address, cache, row_index_D[level], oldest_index);
+          if(block_dirty(cache, row_index_D[level], oldest_index))
           {
             /* write previous data in cache block to memory */
-            dcache_stats[level].words_write_mem += dcache_info[level].words_per_block;
-            if(level == 0 && dcache_info[1].num_blocks != 0) {
-              accessD_Write(address, 1, dcache2);
-            }
-            if(level == 1 && dcache_info[2].num_blocks != 0) {
-              accessD_Write(address, 2, dcache3);
-            }
+            PROF_ENTER(Prof_WRITEBACK, PROF_DCACHE(level));
+            write_back(level, cache, row_index_D[level], oldest_index);
           }
-          cache[row_index_D[level]][oldest_index].tag = tag_D[level];
-          cache[row_index_D[level]][oldest_index].dirty_bit = 0;
+          PROF_ENTER(Prof_FILL, PROF_DCACHE(level));
+          set_tag(cache, row_index_D[level], oldest_index, tag_D[level]);
+          set_dirty(cache, row_index_D[level], oldest_index, 0);
           updateAgeD(oldest_index, level, cache);
         }
-        if(level == 0 && dcache_info[1].num_blocks != 0) {
-          accessD_Read(address, 1, dcache2);
-        }
-        if(level == 1 && dcache_info[2].num_blocks != 0) {
-          accessD_Read(address, 2, dcache3);
-        }
+        fetch_block(address, level, supplied);
         break;
       }
       else
@@ -409,46 +1330,73 @@ void accessD_Read(addr_t address, int level, CacheBlock** cache){
     else
   	{
   		dcache_stats[level].compulsory_reads++;
-  		dcache_stats[level].words_read_mem += dcache_info[level].words_per_block;
-  		cache[row_index_D[level]][col_index_D[level]].valid_bit = 1;
-  		cache[row_index_D[level]][col_index_D[level]].tag = tag_D[level];
+  		PROF_MISS(PROF_DCACHE(level));
+  		PROF_ENTER(Prof_FILL, PROF_DCACHE(level));
+  		supplied = victim_cache_miss(level, address, cache, row_index_D[level], -1);
+  		set_valid(cache, row_index_D[level], col_index_D[level]);
+  		set_tag(cache, row_index_D[level], col_index_D[level], tag_D[level]);
       updateAgeD(col_index_D[level], level, cache);
-      if(level == 0 && dcache_info[1].num_blocks != 0) {
-        accessD_Read(address, 1, dcache2);
-      }
-      if(level == 1 && dcache_info[2].num_blocks != 0) {
-        accessD_Read(address, 2, dcache3);
-      }
+      fetch_block(address, level, supplied);
       break;
   	}
   }
+  if(sector_words[level] != 0)
+    sector_update(level, cache, address, 0);
+  if(fast_path[level + 1])
+    note_mru(level + 1, address >> dcache_setup[level].row_shift, row_index_D[level], col_index_D[level]);
+  if(partitions[level].kind != Partition_NONE)
+    partition_end(level, cache, address);
+  if(watch_misses && !prefetching[level] && level_misses(level) != hot_misses[level + 1])
+    note_miss(level + 1, address);
 }
-void accessD_Write(addr_t address, int level, CacheBlock** cache)
+void accessD_Write(addr_t address, int level, CacheArray* cache)
 {
+  int supplied;
+  if(dcache_setup[level].index == Index_SKEW && cache != &skew_sets[level + 1])
+  {
+    skewed_access(Access_D_WRITE, address, level);
+    return;
+  }
+  if(mru_block[level + 1] == (address >> dcache_setup[level].row_shift) + 1 &&
+    dcache_info[level].write_scheme == Write_WRITE_BACK && dcache_info[level].allocate_scheme == Allocate_ALLOCATE)
+  {
+    /* hit on the MRU way */
+    row_index_D[level] = mru_row[level + 1];
+    col_index_D[level] = mru_col[level + 1];
+    dcache_stats[level].num_writes++;
+    PROF_HIT(PROF_DCACHE(level));
+    set_dirty(cache, row_index_D[level], col_index_D[level], 1);
+    return;
+  }
+  if(prefetch_info[level].kind != Prefetch_NONE)
+    prefetch_demand(level, address);
+  if(partitions[level].kind != Partition_NONE)
+    partition_begin(level, address);
+  if(watch_misses)
+    hot_misses[level + 1] = level_misses(level);
   /* Picking apart the address */
 	word_index_D[level] = (address >> dcache_setup[level].word_shift) & dcache_setup[level].word_mask;
-	row_index_D[level] = (address >> dcache_setup[level].row_shift) & dcache_setup[level].row_mask;
+	row_index_D[level] = set_row(&dcache_setup[level], address);
 	tag_D[level] = (address >> dcache_setup[level].tag_shift) & dcache_setup[level].tag_mask;
 
+  PROF_ENTER(Prof_LOOKUP, PROF_DCACHE(level));
   dcache_stats[level].num_writes++;
   /* Write-through, write-no-allocate (aka write-around)*/
   if(dcache_info[level].write_scheme == Write_WRITE_THROUGH && dcache_info[level].allocate_scheme == Allocate_NO_ALLOCATE)
   {
-    dcache_stats[level].words_write_mem++;
-    if(level == 0 && dcache_info[1].num_blocks != 0) {
-      accessD_Write(address, 1, dcache2);
-    }
-    if(level == 1 && dcache_info[2].num_blocks != 0) {
-      accessD_Write(address, 2, dcache3);
-    }
+    PROF_ENTER(Prof_WRITEBACK, PROF_DCACHE(level));
+    write_through(address, level);
+    PROF_ENTER(Prof_LOOKUP, PROF_DCACHE(level));
     col_index_D[level] = 0;
     while(1)
     {
-      if(cache[row_index_D[level]][col_index_D[level]].valid_bit == 1)
+      if(block_valid(cache, row_index_D[level], col_index_D[level]))
       {
-        if(cache[row_index_D[level]][col_index_D[level]].tag == tag_D[level])
+        if(block_tag(cache, row_index_D[level], col_index_D[level]) == tag_D[level])
         {
           /*hit*/
+          PROF_HIT(PROF_DCACHE(level));
+          PROF_ENTER(Prof_REPLACEMENT, PROF_DCACHE(level));
           /*data written through cache and memory*/
           updateAgeD(col_index_D[level], level, cache);
           break;
@@ -456,12 +1404,14 @@ void accessD_Write(addr_t address, int level, CacheBlock** cache)
         else if(dcache_info[level].associativity == 1)
       	{
       		dcache_stats[level].conflict_writes++;
+      		PROF_MISS(PROF_DCACHE(level));
           break;
       	}
         else if(col_index_D[level] == dcache_setup[level].num_cols-1)
         {
           /* Reached the end of the row and need to kick out a block*/
           dcache_stats[level].capacity_writes++;
+          PROF_MISS(PROF_DCACHE(level));
           break;
         }
         else
@@ -475,10 +1425,12 @@ void accessD_Write(addr_t address, int level, CacheBlock** cache)
         if(dcache_info[level].associativity == 1)
       	{
       		dcache_stats[level].conflict_writes++;
+      		PROF_MISS(PROF_DCACHE(level));
       	}
         else
         {
           dcache_stats[level].capacity_writes++;
+          PROF_MISS(PROF_DCACHE(level));
         }
         break;
     	}
@@ -490,59 +1442,64 @@ void accessD_Write(addr_t address, int level, CacheBlock** cache)
     col_index_D[level] = 0;
     while(1)
     {
-      if(cache[row_index_D[level]][col_index_D[level]].valid_bit == 1)
+      if(block_valid(cache, row_index_D[level], col_index_D[level]))
       {
-        if(cache[row_index_D[level]][col_index_D[level]].tag == tag_D[level])
+        if(block_tag(cache, row_index_D[level], col_index_D[level]) == tag_D[level])
         {
           /*hit*/
+          PROF_HIT(PROF_DCACHE(level));
+          PROF_ENTER(Prof_REPLACEMENT, PROF_DCACHE(level));
           updateAgeD(col_index_D[level], level, cache);
           break;
         }
         else if(dcache_info[level].associativity == 1)
       	{
+          supplied = victim_cache_miss(level, address, cache, row_index_D[level], col_index_D[level]);
           if(dcache_info[level].words_per_block > 1) {
-            dcache_stats[level].words_read_mem += dcache_info[level].words_per_block;
-            if(level == 0 && dcache_info[1].num_blocks != 0) {
-              accessD_Read(address, 1, dcache2);
-            }
-            if(level == 1 && dcache_info[2].num_blocks != 0) {
-              accessD_Read(address, 2, dcache3);
-            }
+            PROF_ENTER(Prof_FILL, PROF_DCACHE(level));
+            fetch_block(address, level, supplied);
           }
-          cache[row_index_D[level]][col_index_D[level]].tag = tag_D[level];
+          set_tag(cache, row_index_D[level], col_index_D[level], tag_D[level]);
           dcache_stats[level].conflict_writes++;
+          PROF_MISS(PROF_DCACHE(level));
           break;
       	}
         else if(col_index_D[level] == dcache_setup[level].num_cols-1)
         {
           /* Reached the end of the row and need to kick out a block*/
           dcache_stats[level].capacity_writes++;
+          PROF_MISS(PROF_DCACHE(level));
+          supplied = victim_cache_miss(level, address, cache, row_index_D[level], -1);
           if(dcache_info[level].words_per_block > 1) {
-            dcache_stats[level].words_read_mem += dcache_info[level].words_per_block;
-            if(level == 0 && dcache_info[1].num_blocks != 0) {
-              accessD_Read(address, 1, dcache2);
-            }
-            if(level == 1 && dcache_info[2].num_blocks != 0) {
-              accessD_Read(address, 2, dcache3);
-            }
+            PROF_ENTER(Prof_FILL, PROF_DCACHE(level));
+            fetch_block(address, level, supplied);
           }
+          PROF_ENTER(Prof_REPLACEMENT, PROF_DCACHE(level));
           if(dcache_info[level].replacement == Replacement_RANDOM)
           {
-            cache[row_index_D[level]][rand() % dcache_setup[level].num_cols].tag = tag_D[level];
+            col_index_D[level] = partitions[level].kind != Partition_NONE ?
+            partition_victim(&partitions[level], cache, row_index_D[level], partition_cls[level], 0) :
+            random_way(dcache_setup[level].num_cols);
+            victim_cache_evict(level, cache, row_index_D[level], col_index_D[level]);
+            set_tag(cache, row_index_D[level], col_index_D[level], tag_D[level]);
           }
           else
           {
             int j;
-            int oldest = cache[row_index_D[level]][level].LRU_age;
+            unsigned int oldest = lru_rank(cache, row_index_D[level], 0);
             int oldest_index = 0;
             for(j = 1; j < dcache_setup[level].num_cols; j++)
             {
-              if(cache[row_index_D[level]][j].LRU_age > oldest) {
-                oldest = cache[row_index_D[level]][j].LRU_age;
+              if(lru_rank(cache, row_index_D[level], j) > oldest) {
+                oldest = lru_rank(cache, row_index_D[level], j);
                 oldest_index = j;
               }
             }
-            cache[row_index_D[level]][oldest_index].tag = tag_D[level];
+            if(partitions[level].kind != Partition_NONE)
+              oldest_index = partition_victim(&partitions[level], cache, row_index_D[level], partition_cls[level], 1);
+            col_index_D[level] = oldest_index;
+            victim_cache_evict(level, cache, row_index_D[level], oldest_index);
+            set_tag(cache, row_index_D[level], oldest_index, tag_D[level]);
             updateAgeD(oldest_index, level, cache);
           }
           break;
@@ -555,29 +1512,21 @@ void accessD_Write(addr_t address, int level, CacheBlock** cache)
       }
       else
     	{
+        supplied = victim_cache_miss(level, address, cache, row_index_D[level], -1);
         if(dcache_info[level].words_per_block > 1) {
-          dcache_stats[level].words_read_mem += dcache_info[level].words_per_block;
-          if(level == 0 && dcache_info[1].num_blocks != 0) {
-            accessD_Read(address, 1, dcache2);
-          }
-          if(level == 1 && dcache_info[2].num_blocks != 0) {
-            accessD_Read(address, 2, dcache3);
-          }
+          PROF_ENTER(Prof_FILL, PROF_DCACHE(level));
+          fetch_block(address, level, supplied);
         }
-        cache[row_index_D[level]][col_index_D[level]].valid_bit = 1;
-        cache[row_index_D[level]][col_index_D[level]].tag = tag_D[level];
+        set_valid(cache, row_index_D[level], col_index_D[level]);
+        set_tag(cache, row_index_D[level], col_index_D[level], tag_D[level]);
         dcache_stats[level].compulsory_writes++;
+        PROF_MISS(PROF_DCACHE(level));
         updateAgeD(col_index_D[level], level, cache);
         break;
     	}
     }
-    dcache_stats[level].words_write_mem++;
-    if(level == 0 && dcache_info[1].num_blocks != 0) {
-      accessD_Write(address, 1, dcache2);
-    }
-    if(level == 1 && dcache_info[2].num_blocks != 0) {
-      accessD_Write(address, 2, dcache3);
-    }
+    PROF_ENTER(Prof_WRITEBACK, PROF_DCACHE(level));
+    write_through(address, level);
   }
   /* Write Back and Write Allocate */
   else if(dcache_info[level].write_scheme == Write_WRITE_BACK && dcache_info[level].allocate_scheme == Allocate_ALLOCATE )
@@ -585,113 +1534,99 @@ void accessD_Write(addr_t address, int level, CacheBlock** cache)
     col_index_D[level] = 0;
     while(1)
     {
-      if(cache[row_index_D[level]][col_index_D[level]].valid_bit == 1)
+      if(block_valid(cache, row_index_D[level], col_index_D[level]))
       {
-        if(cache[row_index_D[level]][col_index_D[level]].tag == tag_D[level])
+        if(block_tag(cache, row_index_D[level], col_index_D[level]) == tag_D[level])
         {
           /*hit*/
+          PROF_HIT(PROF_DCACHE(level));
+          PROF_ENTER(Prof_REPLACEMENT, PROF_DCACHE(level));
           /*update cache but not memory*/
           updateAgeD(col_index_D[level], level, cache);
-          cache[row_index_D[level]][col_index_D[level]].dirty_bit = 1;
+          set_dirty(cache, row_index_D[level], col_index_D[level], 1);
           break;
         }
         else if(dcache_info[level].associativity == 1)
       	{
           /*conflict miss*/
-          if(cache[row_index_D[level]][col_index_D[level]].dirty_bit == 1)
+          supplied = victim_cache_miss(level, address, cache, row_index_D[level], col_index_D[level]);
+          if(block_dirty(cache, row_index_D[level], col_index_D[level]))
           {
             /* write previous data in cache block to memory */
-            dcache_stats[level].words_write_mem += dcache_info[level].words_per_block;
-            if(level == 0 && dcache_info[1].num_blocks != 0) {
-              accessD_Write(address, 1, dcache2);
-            }
-            if(level == 1 && dcache_info[2].num_blocks != 0) {
-              accessD_Write(address, 2, dcache3);
-            }
+            PROF_ENTER(Prof_WRITEBACK, PROF_DCACHE(level));
+            write_back(level, cache, row_index_D[level], col_index_D[level]);
           }
           /* read whole cache block from memory */
           if(dcache_info[level].words_per_block > 1) {
-            dcache_stats[level].words_read_mem += dcache_info[level].words_per_block;
-            if(level == 0 && dcache_info[1].num_blocks != 0) {
-              accessD_Read(address, 1, dcache2);
-            }
-            if(level == 1 && dcache_info[2].num_blocks != 0) {
-              accessD_Read(address, 2, dcache3);
-            }
+            PROF_ENTER(Prof_FILL, PROF_DCACHE(level));
+            fetch_block(address, level, supplied);
           }
+          PROF_ENTER(Prof_FILL, PROF_DCACHE(level));
           /* write new data to cache and update dirty bit*/
-          cache[row_index_D[level]][col_index_D[level]].tag = tag_D[level];
-          cache[row_index_D[level]][col_index_D[level]].dirty_bit = 1;
+          set_tag(cache, row_index_D[level], col_index_D[level], tag_D[level]);
+          set_dirty(cache, row_index_D[level], col_index_D[level], 1);
           dcache_stats[level].conflict_writes++;
+          PROF_MISS(PROF_DCACHE(level));
           break;
       	}
         else if(col_index_D[level] == dcache_setup[level].num_cols-1)
         {
           /* Reached the end of the row and need to kick out a block*/
           dcache_stats[level].capacity_writes++;
+          PROF_MISS(PROF_DCACHE(level));
+          PROF_ENTER(Prof_REPLACEMENT, PROF_DCACHE(level));
           if(dcache_info[level].replacement == Replacement_RANDOM)
           {
-            col_index_D[level] = rand() % dcache_setup[level].num_cols;
-            if(cache[row_index_D[level]][col_index_D[level]].dirty_bit == 1)
+            col_index_D[level] = partitions[level].kind != Partition_NONE ?
+            partition_victim(&partitions[level], cache, row_index_D[level], partition_cls[level], 0) :
+            random_way(dcache_setup[level].num_cols);
+            supplied = victim_cache_miss(level, address, cache, row_index_D[level], col_index_D[level]);
+            if(block_dirty(cache, row_index_D[level], col_index_D[level]))
             {
               /* write previous data in cache block to memory */
-              dcache_stats[level].words_write_mem += dcache_info[level].words_per_block;
-              if(level == 0 && dcache_info[1].num_blocks != 0) {
-                accessD_Write(address, 1, dcache2);
-              }
-              if(level == 1 && dcache_info[2].num_blocks != 0) {
-                accessD_Write(address, 2, dcache3);
-              }
+              PROF_ENTER(Prof_WRITEBACK, PROF_DCACHE(level));
+              write_back(level, cache, row_index_D[level], col_index_D[level]);
             }
             if(dcache_info[level].words_per_block > 1) {
-              dcache_stats[level].words_read_mem += dcache_info[level].words_per_block;
-              if(level == 0 && dcache_info[1].num_blocks != 0) {
-                accessD_Read(address, 1, dcache2);
-              }
-              if(level == 1 && dcache_info[2].num_blocks != 0) {
-                accessD_Read(address, 2, dcache3);
-              }
+              PROF_ENTER(Prof_FILL, PROF_DCACHE(level));
+              fetch_block(address, level, supplied);
             }
+            PROF_ENTER(Prof_FILL, PROF_DCACHE(level));
             /* write new data to cache and update dirty bit*/
-            cache[row_index_D[level]][col_index_D[level]].tag = tag_D[level];
-            cache[row_index_D[level]][col_index_D[level]].dirty_bit = 1;
+            set_tag(cache, row_index_D[level], col_index_D[level], tag_D[level]);
+            set_dirty(cache, row_index_D[level], col_index_D[level], 1);
           }
           else
           {
             int j;
-            int oldest = cache[row_index_D[level]][0].LRU_age;
+            unsigned int oldest = lru_rank(cache, row_index_D[level], 0);
             int oldest_index = 0;
             /* Finds oldest cache block */
             for(j = 1; j < dcache_setup[level].num_cols; j++)
             {
-              if(cache[row_index_D[level]][j].LRU_age > oldest) {
-                oldest = cache[row_index_D[level]][j].LRU_age;
+              if(lru_rank(cache, row_index_D[level], j) > oldest) {
+                oldest = lru_rank(cache, row_index_D[level], j);
                 oldest_index = j;
               }
             }
-            if(cache[row_index_D[level]][oldest_index].dirty_bit == 1)
+            if(partitions[level].kind != Partition_NONE)
+              oldest_index = partition_victim(&partitions[level], cache, row_index_D[level], partition_cls[level], 1);
+            col_index_D[level] = oldest_index;
+            supplied = victim_cache_miss(level, address, cache, row_index_D[level], oldest_index);
+            if(block_dirty(cache, row_index_D[level], oldest_index))
             {
               /* write previous data in cache block to memory */
-              dcache_stats[level].words_write_mem += dcache_info[0].words_per_block;
-              if(level == 0 && dcache_info[1].num_blocks != 0) {
-                accessD_Write(address, 1, dcache2);
-              }
-              if(level == 1 && dcache_info[2].num_blocks != 0) {
-                accessD_Write(address, 2, dcache3);
-              }
+              PROF_ENTER(Prof_WRITEBACK, PROF_DCACHE(level));
+              write_back(level, cache, row_index_D[level], oldest_index);
             }
             if(dcache_info[level].words_per_block > 1) {
-              dcache_stats[level].words_read_mem += dcache_info[level].words_per_block;
-              if(level == 0 && dcache_info[1].num_blocks != 0) {
-                accessD_Read(address, 1, dcache2);
-              }
-              if(level == 1 && dcache_info[2].num_blocks != 0) {
-                accessD_Read(address, 2, dcache3);
-              }
+              PROF_ENTER(Prof_FILL, PROF_DCACHE(level));
+              fetch_block(address, level, supplied);
             }
+            PROF_ENTER(Prof_FILL, PROF_DCACHE(level));
             /* write new data to cache and update dirty bit*/
-            cache[row_index_D[level]][oldest_index].tag = tag_D[level];
-            cache[row_index_D[level]][oldest_index].dirty_bit = 1;
+            set_tag(cache, row_index_D[level], oldest_index, tag_D[level]);
+            set_dirty(cache, row_index_D[level], oldest_index, 1);
             updateAgeD(oldest_index, level, cache);
           }
           break;
@@ -704,101 +1639,619 @@ void accessD_Write(addr_t address, int level, CacheBlock** cache)
       }
       else
     	{
-        cache[row_index_D[level]][col_index_D[level]].valid_bit = 1;
-        cache[row_index_D[level]][col_index_D[level]].tag = tag_D[level];
-        cache[row_index_D[level]][col_index_D[level]].dirty_bit = 1;
+        set_valid(cache, row_index_D[level], col_index_D[level]);
+        set_tag(cache, row_index_D[level], col_index_D[level], tag_D[level]);
+        set_dirty(cache, row_index_D[level], col_index_D[level], 1);
+        supplied = victim_cache_miss(level, address, cache, row_index_D[level], -1);
         if(dcache_info[level].words_per_block > 1) {
-          dcache_stats[level].words_read_mem += dcache_info[level].words_per_block;
-          if(level == 0 && dcache_info[1].num_blocks != 0) {
-            accessD_Read(address, 1, dcache2);
-          }
-          if(level == 1 && dcache_info[2].num_blocks != 0) {
-            accessD_Read(address, 2, dcache3);
-          }
+          PROF_ENTER(Prof_FILL, PROF_DCACHE(level));
+          fetch_block(address, level, supplied);
         }
         dcache_stats[level].compulsory_writes++;
+        PROF_MISS(PROF_DCACHE(level));
         updateAgeD(col_index_D[level], level, cache);
         break;
     	}
     }
   }
+  if(sector_words[level] != 0)
+    sector_update(level, cache, address, 1);
+  /* Without allocation the block may not be there */
+  if(fast_path[level + 1] && dcache_info[level].allocate_scheme == Allocate_ALLOCATE)
+    note_mru(level + 1, address >> dcache_setup[level].row_shift, row_index_D[level], col_index_D[level]);
+  else
+    mru_block[level + 1] = 0;
+  if(partitions[level].kind != Partition_NONE)
+    partition_end(level, cache, address);
+  if(watch_misses && !prefetching[level] && level_misses(level) != hot_misses[level + 1])
+    note_miss(level + 1, address);
+}
+/* Simulates an access and then times it, working out from the statistics and
+  demand_level how deep it went and what it moved to and from memory */
+static void timed_access(AccessType type, addr_t address)
+{
+  CacheStats* last = (type == Access_I_FETCH) ? &icache_stats : &dcache_stats[num_dlevels - 1];
+  long long read_before = last->words_read_mem, write_before = last->words_write_mem;
+  long long misses_before = icache_stats.compulsory_reads + icache_stats.conflict_reads + icache_stats.capacity_reads;
+  unsigned long blocks[TIMING_UNITS];
+  int level, served;
+
+  demand_level = 0;
+  memory_latency = -1;
+  handle_access(type, address);
+
+  if(type == Access_I_FETCH)
+  {
+    blocks[0] = address >> icache_setup.row_shift;
+    served = (icache_stats.compulsory_reads + icache_stats.conflict_reads + icache_stats.capacity_reads) != misses_before;
+  }
+  else
+  {
+    for(level = 0; level < num_dlevels; level++)
+      blocks[level + 1] = address >> dcache_setup[level].row_shift;
+    served = demand_level;
+    if(memory_latency >= 0 && served == num_dlevels)
+      timing_memory_latency(memory_latency);
+  }
+  timing_access(type, served, blocks, last->words_read_mem - read_before, last->words_write_mem - write_before);
+}
+/* Loads one page table entry through the D-caches for a page walk */
+static void walk_load(addr_t address)
+{
+  CacheStats* l1 = &dcache_stats[0];
+  CacheStats* last = &dcache_stats[num_dlevels - 1];
+  long long misses = l1->compulsory_reads + l1->conflict_reads + l1->capacity_reads;
+  long long words = last->words_read_mem;
+  int demand = demand_level;
+
+  /* The walk isn't part of the demand access the timing model follows */
+  demand_level = -1;
+  accessD_Read(address, 0, &dcache);
+  demand_level = demand;
+  walk_stats.loads++;
+  walk_stats.l1_misses += l1->compulsory_reads + l1->conflict_reads + l1->capacity_reads - misses;
+  walk_stats.words_read_mem += last->words_read_mem - words;
+}
+/* Looks an access up in the TLBs and walks the page table on a miss */
+static void translate(AccessType type, addr_t address)
+{
+  addr_t walk[MAX_WALK_LEVELS];
+  int which = type == Access_I_FETCH ? TLB_I : TLB_D;
+  int loads, i;
+
+  if(!tlb_configured(which))
+    return;
+  loads = tlb_translate(which, address, walk);
+  if(page_walks && num_dlevels > 0)
+  {
+    for(i = 0; i < loads; i++)
+      walk_load(walk[i]);
+  }
+}
+void handle_access(AccessType type, addr_t address)
+{
+	/* This is where all the fun stuff happens! This function is called to
+	simulate a memory access. You figure out what type it is, and do all your
+	fun simulation stuff from here. */
+	PROF_ENTER(Prof_DISPATCH, PROF_TRACE);
+	accesses_seen++;
+	if(tlb_enabled)
+		translate(type, address);
+	switch(type)
+	{
+		case Access_I_FETCH:
+			accessI(address);
+			//printf("I_FETCH at %08lx\n", address);
+			break;
+		case Access_D_READ:
+			//printf("D_READ at %08lx\n", address);
+      if(dcache_info[0].num_blocks != 0)
+      {
+        accessD_Read(address, 0, &dcache);
+      }
+			break;
+		case Access_D_WRITE:
+			//printf("D_WRITE at %08lx\n", address);
+      if(dcache_info[0].num_blocks != 0)
+      {
+        accessD_Write(address, 0, &dcache);
+      }
+			break;
+	}
+	PROF_ENTER(Prof_PARSE, PROF_TRACE);
+}
+/* Makes core's private caches the current ones */
+static void switch_core(int core)
+{
+  CoreContext* c;
+  if(core == current_core)
+    return;
+  c = &cores[current_core];
+  c->icache = icache;
+  c->dcache = dcache;
+  c->icache_stats = icache_stats;
+  c->dcache_stats = dcache_stats[0];
+  c = &cores[core];
+  icache = c->icache;
+  dcache = c->dcache;
+  icache_stats = c->icache_stats;
+  dcache_stats[0] = c->dcache_stats;
+  current_core = core;
+}
+/* Removes a block from a set. The lookups stop at the first invalid way, so
+  the ways after it move down one, taking their LRU ranks with them, and the
+  freed way goes last as the least recently used. */
+static void invalidate_block(CacheArray* cache, int row, int col)
+{
+  unsigned int rank = lru_rank(cache, row, col);
+  int ways = cache->num_cols, j;
+  for(j = 0; j < ways; j++)
+  {
+    if(lru_rank(cache, row, j) > rank)
+      set_lru_rank(cache, row, j, lru_rank(cache, row, j) - 1);
+  }
+  for(j = col; j < ways - 1; j++)
+  {
+    *block_at(cache, row, j) = *block_at(cache, row, j + 1);
+    set_lru_rank(cache, row, j, lru_rank(cache, row, j + 1));
+  }
+  clear_block(cache, row, ways - 1);
+  set_lru_rank(cache, row, ways - 1, ways - 1);
+}
+/* Finds a core's L1 copy of address; if it is Modified, writes it back to
+  the next level. Then drops the copy if invalidate is set, otherwise leaves
+  it clean. Returns 0 if the core had no copy, 1 if its copy was clean and 2
+  if it was Modified and had to be written back. */
+static int recall_copy(int core, addr_t address, int invalidate)
+{
+  CacheArray* cache = core == current_core ? &dcache : &cores[core].dcache;
+  CacheStats* stats = core == current_core ? &dcache_stats[0] : &cores[core].dcache_stats;
+  int row = set_row(&dcache_setup[0], address);
+  int col = find_block_in(cache, 0, address), modified = 0;
+
+  if(col < 0)
+    return 0;
+  if(block_dirty(cache, row, col))
+  {
+    stats->words_write_mem += dcache_info[0].words_per_block;
+    if(hot_k)
+      hot_writeback(0, address >> dcache_setup[0].row_shift);
+    write_next_level(address, 0, dcache_info[0].words_per_block);
+    set_dirty(cache, row, col, 0);
+    modified = 1;
+  }
+  if(invalidate)
+    invalidate_block(cache, row, col);
+  return 1 + modified;
+}
+/* Simulates an access by one core, keeping the L1 D-caches coherent (see
+  coherence.h) */
+static void core_access(int core, AccessType type, addr_t address)
+{
+  unsigned int bit = 1u << core, word_bit;
+  DirEntry* e;
+  int d, present, invalidated = 0;
+
+  switch_core(core);
+  if(type == Access_I_FETCH || num_dlevels == 0)
+  {
+    handle_access(type, address);
+    return;
+  }
+
+  word_bit = 1u << ((address >> dcache_setup[0].word_shift) & dcache_setup[0].word_mask);
+  e = directory_find(address >> dcache_setup[0].row_shift);
+  present = find_block(0, address) >= 0;
+  if(!present)
+  {
+    if(e->lost & bit)
+      coherence_stats[core].coherence_misses++;
+    e->lost &= ~bit;
+    e->words[core] = 0;
+  }
+
+  if(type == Access_D_READ)
+  {
+    if(e->owner >= 0 && e->owner != core)
+    {
+      if(recall_copy(e->owner, address, 0) == 2)
+        coherence_stats[core].interventions++;
+      e->owner = -1;
+    }
+  }
+  else
+  {
+    for(d = 0; d < num_cores; d++)
+    {
+      if(d == core || !(e->sharers & (1u << d)) || !recall_copy(d, address, 1))
+        continue;
+      invalidated = 1;
+      coherence_stats[d].invalidations++;
+      e->invalidations++;
+      e->lost |= 1u << d;
+      if(!(e->words[d] & word_bit))
+      {
+        coherence_stats[d].false_sharing++;
+        e->false_sharing++;
+      }
+    }
+    if(present && invalidated)
+      coherence_stats[core].upgrades++;
+    e->sharers = 0;
+    e->owner = core;
+  }
+
+  handle_access(type, address);
+  e->sharers |= bit;
+  e->words[core] |= word_bit;
+}
+/* Prefetches the metadata of the set an access will touch in one cache:
+  the start of the row's blocks and its LRU ranks */
+static void prefetch_set(CacheArray* cache, CacheSetup* setup, addr_t address)
+{
+  unsigned long row = set_row(setup, address);
+  __builtin_prefetch(&cache->blocks[row * cache->num_cols], 1);
+  if(cache->lru_bytes != 0)
+    __builtin_prefetch(&cache->lru[row * cache->lru_bytes], 1);
+}
+/* How many accesses from a on are of its type and in its L1 block, if the
+  fast path would take the repeats */
+static int run_length(const MemAccess* a, int count)
+{
+  unsigned long block;
+  int shift, n;
+
+  if(a->type == Access_I_FETCH)
+  {
+    if(!fast_path[0])
+      return 1;
+    shift = icache_setup.row_shift;
+  }
+  else
+  {
+    if(!fast_path[1] || (a->type == Access_D_WRITE && (dcache_info[0].write_scheme != Write_WRITE_BACK ||
+      dcache_info[0].allocate_scheme != Allocate_ALLOCATE)))
+      return 1;
+    shift = dcache_setup[0].row_shift;
+  }
+  block = a->address >> shift;
+  for(n = 1; n < count && a[n].type == a->type && (a[n].address >> shift) == block; n++)
+    ;
+  return n;
+}
+/* Simulates a run of n accesses of one type to one L1 block. The first one
+  leaves the block in the L1's MRU way, so the rest are credited as the fast
+  path hits they would be. */
+static void handle_run(AccessType type, addr_t address, int n)
+{
+  handle_access(type, address);
+  accesses_seen += n - 1;
+  if(type == Access_I_FETCH)
+  {
+    icache_stats.num_reads += n - 1;
+    PROF_HITS(PROF_ICACHE, n - 1);
+  }
+  else
+  {
+    if(type == Access_D_READ)
+      dcache_stats[0].num_reads += n - 1;
+    else
+      dcache_stats[0].num_writes += n - 1;
+    PROF_HITS(PROF_DCACHE(0), n - 1);
+  }
 }
-void handle_access(AccessType type, addr_t address)
+static const char* check_names[4] = { "I-cache", "L1 D-cache", "L2 D-cache", "L3 D-cache" };
+
+static CacheArray* check_array(int x)
 {
-	/* This is where all the fun stuff happens! This function is called to
-	simulate a memory access. You figure out what type it is, and do all your
-	fun simulation stuff from here. */
-	switch(type)
-	{
-		case Access_I_FETCH:
-			accessI(address);
-			//printf("I_FETCH at %08lx\n", address);
-			break;
-		case Access_D_READ:
-			//printf("D_READ at %08lx\n", address);
-      if(dcache_info[0].num_blocks != 0)
-      {
-        accessD_Read(address, 0, dcache);
-      }
-			break;
-		case Access_D_WRITE:
-			//printf("D_WRITE at %08lx\n", address);
-      if(dcache_info[0].num_blocks != 0)
+  return x == 0 ? &icache : dcache_array(x - 1);
+}
+static CacheSetup* check_setup(int x)
+{
+  return x == 0 ? &icache_setup : &dcache_setup[x - 1];
+}
+/* The first counter the simulator and the reference disagree on, or NULL,
+  with the two values */
+#define CHECK_STAT(f) if(a->f != b->f) { *ours = a->f; *theirs = b->f; return #f; }
+static const char* stats_diff(const CacheStats* a, const CacheStats* b, long long* ours, long long* theirs)
+{
+  CHECK_STAT(num_reads);
+  CHECK_STAT(num_writes);
+  CHECK_STAT(words_read_mem);
+  CHECK_STAT(words_write_mem);
+  CHECK_STAT(compulsory_reads);
+  CHECK_STAT(conflict_reads);
+  CHECK_STAT(capacity_reads);
+  CHECK_STAT(compulsory_writes);
+  CHECK_STAT(conflict_writes);
+  CHECK_STAT(capacity_writes);
+  return NULL;
+}
+#undef CHECK_STAT
+/* Returns the first way of a set the two engines disagree on, or -1. Invalid
+  ways only have to agree on being invalid, and ranks only matter for LRU. */
+static int set_diff(int x, int row)
+{
+  CacheArray* a = check_array(x);
+  RefCache* c = &reference.caches[x];
+  RefWay* w;
+  int j;
+  for(j = 0; j < a->num_cols; j++)
+  {
+    w = &c->ways[row * a->num_cols + j];
+    if(block_valid(a, row, j) != w->valid)
+      return j;
+    if(!w->valid)
+      continue;
+    if(stored_block(check_setup(x), block_tag(a, row, j), row) != w->block || block_dirty(a, row, j) != w->dirty)
+      return j;
+    if(c->info.replacement == Replacement_LRU && a->num_cols > 1 && (int)lru_rank(a, row, j) != ref_rank(c, row, j))
+      return j;
+  }
+  return -1;
+}
+static void dump_set(int x, int row)
+{
+  CacheArray* a = check_array(x);
+  RefCache* c = &reference.caches[x];
+  RefWay* w;
+  int j, lru = c->info.replacement == Replacement_LRU && a->num_cols > 1;
+  fprintf(stderr, "  %s set %d, way: simulator | reference (valid, dirty, block%s)\n", check_names[x], row,
+    lru ? ", LRU rank" : "");
+  for(j = 0; j < a->num_cols; j++)
+  {
+    w = &c->ways[row * a->num_cols + j];
+    fprintf(stderr, "    %2d: %c%c %#10lx", j, block_valid(a, row, j) ? 'V' : '-', block_dirty(a, row, j) ? 'D' : '-',
+      stored_block(check_setup(x), block_tag(a, row, j), row));
+    if(lru)
+      fprintf(stderr, " %2u", lru_rank(a, row, j));
+    fprintf(stderr, " | %c%c %#10lx", w->valid ? 'V' : '-', w->dirty ? 'D' : '-', w->block);
+    if(lru && w->valid)
+      fprintf(stderr, " %2d", ref_rank(c, row, j));
+    fprintf(stderr, "\n");
+  }
+}
+/* Runs n accesses, which the simulator has just done, through the reference
+  model and compares the two. At the first divergence it reports the access,
+  what differs and every set the accesses touched, and exits. */
+static void check_run(const MemAccess* a, int n)
+{
+  static const char* types[3] = { "I-fetch", "read", "write" };
+  CacheStats* stats[4] = { &icache_stats, &dcache_stats[0], &dcache_stats[1], &dcache_stats[2] };
+  const char* stat = NULL;
+  long long ours, theirs;
+  int i, x, row = 0, way = -1;
+
+  reference.num_touched = 0;
+  for(i = 0; i < n; i++)
+    ref_access(&reference, a[i].type, a[i].address);
+  if(reference.error == NULL && reference.next_draw != reference.num_draws)
+    reference.error = "the simulator made a random draw the reference didn't use";
+  reference.num_draws = reference.next_draw = 0;
+  checked += n;
+
+  for(x = 0; x <= num_dlevels && stat == NULL; x++)
+    stat = stats_diff(stats[x], &reference.caches[x].stats, &ours, &theirs);
+  for(i = 0; i < reference.num_touched && stat == NULL && way < 0; i++)
+  {
+    x = reference.touched_cache[i];
+    row = reference.touched_set[i];
+    way = set_diff(x, row);
+  }
+  if(reference.error == NULL && stat == NULL && way < 0)
+    return;
+
+  a += n - 1;
+  fprintf(stderr, "--check: divergence at access %llu (%s of %#lx", checked, types[a->type], a->address);
+  if(n > 1)
+    fprintf(stderr, ", the last of a run of %d", n);
+  fprintf(stderr, ")\n");
+  if(reference.error != NULL)
+    fprintf(stderr, "  %s\n", reference.error);
+  else if(stat != NULL)
+    fprintf(stderr, "  %s %s is %lld, the reference has %lld\n", check_names[x - 1], stat, ours, theirs);
+  else
+    fprintf(stderr, "  %s set %d differs at way %d\n", check_names[x], row, way);
+  for(i = 0; i < reference.num_touched; i++)
+    dump_set(reference.touched_cache[i], reference.touched_set[i]);
+  exit(1);
+}
+/* Simulates count accesses in order. While access i is simulated, the sets
+  that access i + BATCH_PREFETCH_DISTANCE can touch are prefetched, so the
+  host cache misses on big simulated caches overlap with useful work instead
+  of stalling every access. The results are exactly the same as calling
+  handle_access() on each one in turn. */
+void handle_accesses(const MemAccess* accesses, int count)
+{
+  CacheArray* caches[3] = { &dcache, &dcache2, &dcache3 };
+  const MemAccess* ahead;
+  int i, level, n;
+  for(i = 0; i < count; i += n)
+  {
+    n = 1;
+    if(i + BATCH_PREFETCH_DISTANCE < count)
+    {
+      ahead = &accesses[i + BATCH_PREFETCH_DISTANCE];
+      if(ahead->type == Access_I_FETCH)
+        prefetch_set(&icache, &icache_setup, ahead->address);
+      else
       {
-        accessD_Write(address, 0, dcache);
+        for(level = 0; level < 3 && dcache_info[level].num_blocks != 0; level++)
+          prefetch_set(caches[level], &dcache_setup[level], ahead->address);
       }
-			break;
-	}
+    }
+    if(num_cores > 1)
+      core_access(accesses[i].core, accesses[i].type, accesses[i].address);
+    else if(timing_enabled && (accesses[i].type == Access_I_FETCH || num_dlevels > 0))
+      timed_access(accesses[i].type, accesses[i].address);
+    else if(compact_runs && (n = run_length(&accesses[i], count - i)) > 1)
+      handle_run(accesses[i].type, accesses[i].address, n);
+    else
+      handle_access(accesses[i].type, accesses[i].address);
+    if(check_accesses)
+      check_run(&accesses[i], n);
+  }
+}
+void print_victim_stats(int level)
+{
+  VictimCache* v = &victim_caches[level];
+  printf("\t%s cache (%d entries):\n", v->info.kind == Victim_VICTIM ? "Victim" : "Miss", v->info.entries);
+  printf("\t\tProbes: %lld\n\t\tHits: %lld (%.2f%%)\n", v->stats.probes, v->stats.hits,
+    v->stats.probes ? (double)v->stats.hits / v->stats.probes * 100 : 0.0);
+  printf("\t\t%s misses absorbed: %lld\n", dcache_info[level].associativity == 1 ? "Conflict" : "Capacity", v->stats.hits);
+  printf("\t\tWords read from memory saved: %lld\n", v->stats.words_saved);
+}
+void print_hot_spots()
+{
+  static const char* names[] = { "I-cache", "L1 D-cache", "L2 D-cache", "L3 D-cache" };
+  static const char* kinds[] = { "blocks by misses", "regions by misses", "blocks by writebacks", "regions by writebacks" };
+  char what[64];
+  int x, t, shift;
+
+  printf("\n\nHot spots:\n");
+  for(x = 0; x <= num_dlevels; x++)
+  {
+    for(t = 0; t < 4 && (x > 0 || t < Hot_BLOCK_WRITEBACKS); t++)
+    {
+      shift = (t == Hot_REGION_MISSES || t == Hot_REGION_WRITEBACKS) ? hot_region_bits :
+        x == 0 ? icache_setup.row_shift : dcache_setup[x - 1].row_shift;
+      snprintf(what, sizeof(what), "%s %s", names[x], kinds[t]);
+      print_hot(what, &hot_trackers[x][t], shift, hot_k);
+    }
+  }
+}
+void print_tlb_stats()
+{
+  print_tlb();
+  if(!page_walks || num_dlevels == 0)
+    return;
+  printf("\tPage walk D-cache traffic:\n");
+  printf("\t\tPage table loads: %d\n\t\tL1 D-cache misses: %d\n", walk_stats.loads, walk_stats.l1_misses);
+  printf("\t\tWords read from memory: %d\n", walk_stats.words_read_mem);
+}
+void print_sector_stats(int level)
+{
+  SectorStats* t = &sector_stats[level];
+  printf("\tSectors (%d words each, %d per block):\n", sector_words[level], dcache_info[level].words_per_block / sector_words[level]);
+  printf("\t\tSector misses (tag hit, sector missing): %d\n", t->sector_misses);
+  printf("\t\tWords read: %d sectored, %d whole-block (%.2f%% less)\n", t->words_read, t->block_words_read,
+    t->block_words_read ? 100.0 * (t->block_words_read - t->words_read) / t->block_words_read : 0.0);
+  printf("\t\tWords written back: %d sectored, %d whole-block (%.2f%% less)\n", t->words_written, t->block_words_written,
+    t->block_words_written ? 100.0 * (t->block_words_written - t->words_written) / t->block_words_written : 0.0);
+}
+void print_write_buffer_stats(int level)
+{
+  WriteBuffer* b = &write_buffers[level];
+  WriteBufferStats* w = &b->stats;
+  printf("\tWrite buffer (%d entries, %s drain", b->info.entries, b->info.drain == Drain_EAGER ? "eager" : "full");
+  if(b->info.high_water < b->info.entries)
+    printf(", high water %d", b->info.high_water);
+  printf("):\n");
+  printf("\t\tStores buffered: %lld\n\t\tCombined: %lld (%.2f%%)\n", w->stores, w->combined,
+    w->stores ? (double)w->combined / w->stores * 100 : 0.0);
+  printf("\t\tBuffer-full stalls: %lld\n", w->full_stalls);
+  printf("\t\tWrites sent to next level: %lld (%lld fewer than stores)\n", w->drains, w->stores - w->drains);
+  printf("\t\tWords written to next level: %lld\n", w->words_drained);
+  printf("\t\tRead-after-write matches: %lld\n\t\tReads that drained a buffered write: %lld\n", w->raw_matches, w->raw_drains);
+}
+void print_prefetch_stats(int level)
+{
+  PrefetchStats* p = &prefetch_stats[level];
+  long long read_misses = dcache_stats[level].compulsory_reads + dcache_stats[level].conflict_reads + dcache_stats[level].capacity_reads;
+  printf("\tPrefetcher (%s):\n", prefetcher_name(prefetch_info[level].kind));
+  printf("\t\tPrefetches issued: %lld\n\t\tPrefetches filled: %lld\n", p->issued, p->filled);
+  printf("\t\tUseful: %lld\n\t\tLate: %lld\n\t\tPolluting: %lld\n", p->useful, p->late, p->polluting);
+  printf("\t\tRedundant: %lld\n\t\tDropped: %lld\n", p->redundant, p->dropped);
+  printf("\t\tAccuracy: %.2f%%\n", p->filled ? (double)p->useful / p->filled * 100 : 0.0);
+  printf("\t\tCoverage: %.2f%%\n", (p->useful + read_misses) ? (double)p->useful / (p->useful + read_misses) * 100 : 0.0);
+  printf("\t\tExtra words read from memory: %lld\n\t\tExtra words written to memory: %lld\n", p->words_read_mem, p->words_write_mem);
 }
 void print_stats_D(int level)
 {
   dcache_stats[level].total_misses = dcache_stats[level].compulsory_reads + dcache_stats[level].conflict_reads + dcache_stats[level].capacity_reads;
   dcache_stats[level].miss_rate = ((double)dcache_stats[level].total_misses / (double)dcache_stats[level].num_reads) * 100;
   printf("\n\nL%d D-Cache statistics: \n", level+1);
-  printf("\tNumber of reads performed: %d\n\tWords read from memory: %d\n", dcache_stats[level].num_reads,dcache_stats[level].words_read_mem);
-  printf("\tNumber of writes performed: %d\n\tWords written to memory: %d\n", dcache_stats[level].num_writes, dcache_stats[level].words_write_mem);
-  printf("\tRead misses:\n\t\tCompulsory misses: %d", dcache_stats[level].compulsory_reads);
+  printf("\tNumber of reads performed: %lld\n\tWords read from memory: %lld\n", dcache_stats[level].num_reads,dcache_stats[level].words_read_mem);
+  printf("\tNumber of writes performed: %lld\n\tWords written to memory: %lld\n", dcache_stats[level].num_writes, dcache_stats[level].words_write_mem);
+  printf("\tRead misses:\n\t\tCompulsory misses: %lld", dcache_stats[level].compulsory_reads);
   if(dcache_info[level].associativity == 1) {
-    printf("\n\t\tConflict misses: %d\n", dcache_stats[level].conflict_reads);
+    printf("\n\t\tConflict misses: %lld\n", dcache_stats[level].conflict_reads);
   }
   else{
-    printf("\n\t\tCapacity misses: %d\n", dcache_stats[level].capacity_reads);
+    printf("\n\t\tCapacity misses: %lld\n", dcache_stats[level].capacity_reads);
   }
-  printf("\t\tTotal read misses: %d\n\t\tMiss rate: %.2f%%\n", dcache_stats[level].total_misses, dcache_stats[level].miss_rate);
-  printf("\t\tTotal read misses (excluding compulsory): %d\n\t\tMiss rate: %.2f%%\n", (dcache_stats[level].total_misses - dcache_stats[level].compulsory_reads), (double)(dcache_stats[level].total_misses - dcache_stats[level].compulsory_reads)/(double)dcache_stats[level].num_reads*100);
-  printf("\tWrite misses:\n\t\tCompulsory misses: %d", dcache_stats[level].compulsory_writes);
+  printf("\t\tTotal read misses: %lld\n\t\tMiss rate: %.2f%%\n", dcache_stats[level].total_misses, dcache_stats[level].miss_rate);
+  printf("\t\tTotal read misses (excluding compulsory): %lld\n\t\tMiss rate: %.2f%%\n", (dcache_stats[level].total_misses - dcache_stats[level].compulsory_reads), (double)(dcache_stats[level].total_misses - dcache_stats[level].compulsory_reads)/(double)dcache_stats[level].num_reads*100);
+  printf("\tWrite misses:\n\t\tCompulsory misses: %lld", dcache_stats[level].compulsory_writes);
   if(dcache_info[level].associativity == 1) {
-    printf("\n\t\tConflict misses: %d\n", dcache_stats[level].conflict_writes);
+    printf("\n\t\tConflict misses: %lld\n", dcache_stats[level].conflict_writes);
   }
   else{
-    printf("\n\t\tCapacity misses: %d\n", dcache_stats[level].capacity_writes);
+    printf("\n\t\tCapacity misses: %lld\n", dcache_stats[level].capacity_writes);
   }
   dcache_stats[level].total_misses = dcache_stats[level].compulsory_writes+dcache_stats[level].conflict_writes+dcache_stats[level].capacity_writes;
   dcache_stats[level].miss_rate = ((double)dcache_stats[level].total_misses / (double)dcache_stats[level].num_writes) * 100;
-  printf("\t\tTotal write misses: %d\n\t\tMiss rate: %.2f%%\n", dcache_stats[level].total_misses, dcache_stats[level].miss_rate);
-  printf("\t\tTotal write misses (excluding compulsory): %d\n\t\tMiss rate: %.2f%%\n", (dcache_stats[level].conflict_writes+dcache_stats[level].capacity_writes), (double)(dcache_stats[level].conflict_writes+dcache_stats[level].capacity_writes)/(double)dcache_stats[level].num_writes*100);
+  printf("\t\tTotal write misses: %lld\n\t\tMiss rate: %.2f%%\n", dcache_stats[level].total_misses, dcache_stats[level].miss_rate);
+  printf("\t\tTotal write misses (excluding compulsory): %lld\n\t\tMiss rate: %.2f%%\n", (dcache_stats[level].conflict_writes+dcache_stats[level].capacity_writes), (double)(dcache_stats[level].conflict_writes+dcache_stats[level].capacity_writes)/(double)dcache_stats[level].num_writes*100);
+  if(prefetch_info[level].kind != Prefetch_NONE)
+  {
+    print_prefetch_stats(level);
+  }
+  if(victim_caches[level].info.kind != Victim_NONE)
+  {
+    print_victim_stats(level);
+  }
+  if(write_buffers[level].info.entries != 0)
+  {
+    print_write_buffer_stats(level);
+  }
+  if(sector_words[level] != 0)
+  {
+    print_sector_stats(level);
+  }
+  if(partitions[level].kind != Partition_NONE)
+  {
+    print_partition(&partitions[level], dcache_array(level));
+  }
 }
-void print_statistics()
+static void print_stats_I()
 {
-	/* Finally, after all the simulation happens, you have to show what the
-	results look like. Do that here.*/
   icache_stats.total_misses =  icache_stats.compulsory_reads + icache_stats.conflict_reads + icache_stats.capacity_reads;
   icache_stats.miss_rate = ((double)icache_stats.total_misses / (double)icache_stats.num_reads) * 100;
 	printf("I-Cache statistics: \n");
-	printf("\tNumber of reads performed: %d\n\tWords read from memory: %d\n", icache_stats.num_reads,icache_stats.words_read_mem);
-	printf("\tRead misses:\n\t\tCompulsory misses: %d", icache_stats.compulsory_reads);
+	printf("\tNumber of reads performed: %lld\n\tWords read from memory: %lld\n", icache_stats.num_reads,icache_stats.words_read_mem);
+	printf("\tRead misses:\n\t\tCompulsory misses: %lld", icache_stats.compulsory_reads);
   if(icache_info.associativity == 1) {
-    printf("\n\t\tConflict misses: %d\n", icache_stats.conflict_reads);
+    printf("\n\t\tConflict misses: %lld\n", icache_stats.conflict_reads);
   }
   else{
-    printf("\n\t\tCapacity misses: %d\n", icache_stats.capacity_reads);
+    printf("\n\t\tCapacity misses: %lld\n", icache_stats.capacity_reads);
   }
-	printf("\t\tTotal read misses: %d\n\t\tMiss rate: %.2f%%\n", icache_stats.total_misses, icache_stats.miss_rate);
-	printf("\t\tTotal read misses (excluding compulsory): %d\n\t\tMiss rate: %.2f%%\n", (icache_stats.conflict_reads + icache_stats.capacity_reads), (double)(icache_stats.conflict_reads + icache_stats.capacity_reads)/(double)icache_stats.num_reads*100);
+	printf("\t\tTotal read misses: %lld\n\t\tMiss rate: %.2f%%\n", icache_stats.total_misses, icache_stats.miss_rate);
+	printf("\t\tTotal read misses (excluding compulsory): %lld\n\t\tMiss rate: %.2f%%\n", (icache_stats.conflict_reads + icache_stats.capacity_reads), (double)(icache_stats.conflict_reads + icache_stats.capacity_reads)/(double)icache_stats.num_reads*100);
 
-  if(dcache_info[0].num_blocks != 0)
+}
+void print_statistics()
+{
+  int core;
+	/* Finally, after all the simulation happens, you have to show what the
+	results look like. Do that here.*/
+  for(core = 0; core < num_cores; core++)
   {
-    print_stats_D(0);
+    if(num_cores > 1)
+    {
+      switch_core(core);
+      printf("%sCore %d:\n", core ? "\n\n" : "", core);
+    }
+    print_stats_I();
+    if(dcache_info[0].num_blocks != 0)
+    {
+      print_stats_D(0);
+    }
+    if(num_cores > 1 && dcache_info[0].num_blocks != 0)
+    {
+      print_coherence_stats(core);
+    }
   }
   if(dcache_info[1].num_blocks != 0)
   {
@@ -808,6 +2261,10 @@ void print_statistics()
   {
     print_stats_D(2);
   }
+  if(num_cores > 1 && dcache_info[0].num_blocks != 0)
+  {
+    print_false_sharing(dcache_setup[0].row_shift, 10);
+  }
 }
 
 /*******************************************************************************
@@ -829,6 +2286,7 @@ void dump_cache_info()
 	printf("\t%d blocks\n", icache_info.num_blocks);
 	printf("\t%d word(s) per block\n", icache_info.words_per_block);
 	printf("\t%d-way associative\n", icache_info.associativity);
+	printf("\t%s index\n", index_names[icache_info.index]);
 
 	if(icache_info.associativity > 1)
 	{
@@ -846,6 +2304,7 @@ void dump_cache_info()
 		printf("\t%d blocks\n", info->num_blocks);
 		printf("\t%d word(s) per block\n", info->words_per_block);
 		printf("\t%d-way associative\n", info->associativity);
+		printf("\t%s index\n", index_names[info->index]);
 
 		if(info->associativity > 1)
 		{
@@ -862,35 +2321,6 @@ void dump_cache_info()
 	}
 }
 
-void read_trace_line(FILE* trace)
-{
-	char line[100];
-	addr_t address;
-	char type;
-
-	if(fgets(line, sizeof(line), trace) == NULL)
-		return;
-
-	if(sscanf(line, "0x%lx %c", &address, &type) < 2)
-	{
-		// fprintf(stderr, "Malformed trace file.\n");
-		// exit(1);
-    return;
-	}
-
-	switch(type)
-	{
-		case 'R': handle_access(Access_D_READ, address);  break;
-		case 'W': handle_access(Access_D_WRITE, address); break;
-		case 'I': handle_access(Access_I_FETCH, address); break;
-		default:
-			fprintf(stderr, "Malformed trace file: invalid access type '%c'.\n",
-				type);
-			exit(1);
-			break;
-	}
-}
-
 static void bad_params(const char* msg)
 {
 	fprintf(stderr, msg);
@@ -899,13 +2329,38 @@ static void bad_params(const char* msg)
 }
 
 #define streq(a, b) (strcmp((a), (b)) == 0)
+#define TRACE_BATCH 4096
+
+/* Reads the optional index item at the end of -I and -D */
+static IndexType parse_index(const char* name)
+{
+	int i;
+	for(i = 0; i < 5; i++)
+	{
+		if(streq(name, index_names[i]))
+			return (IndexType)i;
+	}
+	bad_params("Invalid cache index function.");
+	return Index_PLAIN;
+}
+/* Checks that a cache's geometry works with its index function */
+static void check_index(const CacheInfo* info)
+{
+	int sets = info->num_blocks / info->associativity;
+	if(power_of_two(info->words_per_block) < 0)
+		bad_params("Words per block must be a power of two.");
+	if(info->index != Index_MOD && info->index != Index_PRIME && power_of_two(sets) < 0)
+		bad_params("The number of sets must be a power of two; use the mod or prime index for other counts.");
+	if(info->index == Index_SKEW && (info->associativity < 2 || info->associativity > MAX_SKEW_WAYS))
+		bad_params("A skewed cache needs 2 to 16 ways.");
+}
 
-FILE* parse_arguments(int argc, char** argv)
+TraceReader* parse_arguments(int argc, char** argv)
 {
 	int i;
 	int have_inst = 0;
 	int have_data[3] = {};
-	FILE* trace = NULL;
+	TraceReader* trace = NULL;
 	int level;
 	int num_blocks;
 	int words_per_block;
@@ -914,6 +2369,15 @@ FILE* parse_arguments(int argc, char** argv)
 	char alloc_scheme;
 	char replace_scheme;
 	int converted;
+	char index_name[16];
+	PrefetchInfo pf_info;
+	VictimInfo victim_info;
+	WriteBufferInfo write_buffer_info;
+	TlbInfo tlb;
+	Partition partition;
+	TimingInfo timing;
+	MemoryTimingInfo memory_timing;
+	DramInfo dram;
 
 	for(i = 1; i < argc; i++)
 	{
@@ -927,15 +2391,18 @@ FILE* parse_arguments(int argc, char** argv)
 			have_inst = 1;
 
 			i++;
-			converted = sscanf(argv[i], "%d:%d:%d:%c",
+			converted = sscanf(argv[i], "%d:%d:%d:%c:%15s",
 				&icache_info.num_blocks,
 				&icache_info.words_per_block,
 				&icache_info.associativity,
-				&replace_scheme);
+				&replace_scheme,
+				index_name);
 
 			if(converted < 4)
 				bad_params("Invalid I-cache parameters.");
 
+			icache_info.index = converted == 5 ? parse_index(index_name) : Index_PLAIN;
+
 			if(icache_info.associativity > 1)
 			{
 				if(replace_scheme == 'R')
@@ -952,9 +2419,9 @@ FILE* parse_arguments(int argc, char** argv)
 				bad_params("Expected parameters after -D.");
 
 			i++;
-			converted = sscanf(argv[i], "%d:%d:%d:%d:%c:%c:%c",
+			converted = sscanf(argv[i], "%d:%d:%d:%d:%c:%c:%c:%15s",
 				&level, &num_blocks, &words_per_block, &associativity,
-				&replace_scheme, &write_scheme, &alloc_scheme);
+				&replace_scheme, &write_scheme, &alloc_scheme, index_name);
 
 			if(converted < 7)
 				bad_params("Invalid D-cache parameters.");
@@ -971,6 +2438,7 @@ FILE* parse_arguments(int argc, char** argv)
 			dcache_info[level].num_blocks = num_blocks;
 			dcache_info[level].words_per_block = words_per_block;
 			dcache_info[level].associativity = associativity;
+			dcache_info[level].index = converted == 8 ? parse_index(index_name) : Index_PLAIN;
 
 			if(associativity > 1)
 			{
@@ -996,8 +2464,203 @@ FILE* parse_arguments(int argc, char** argv)
 			else
 				bad_params("Invalid D-cache allocation scheme.");
 		}
+		else if(streq(argv[i], "--profile"))
+		{
+#ifdef CACHESIM_PROFILE
+			want_profile = 1;
+#else
+			bad_params("Profiling is compiled out; rebuild with make PROFILE=1.");
+#endif
+		}
+		else if(streq(argv[i], "-P"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected parameters after -P.");
+
+			i++;
+			if(parse_prefetcher(argv[i], &level, &pf_info) != 0)
+				bad_params("Invalid prefetcher parameters.");
+			prefetch_info[level] = pf_info;
+		}
+		else if(streq(argv[i], "-V"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected parameters after -V.");
+
+			i++;
+			if(parse_victim(argv[i], &level, &victim_info) != 0)
+				bad_params("Invalid victim cache parameters.");
+			victim_caches[level].info = victim_info;
+		}
+		else if(streq(argv[i], "-B"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected parameters after -B.");
+
+			i++;
+			if(parse_write_buffer(argv[i], &level, &write_buffer_info) != 0)
+				bad_params("Invalid write buffer parameters.");
+			write_buffers[level].info = write_buffer_info;
+		}
+		else if(streq(argv[i], "-S"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected parameters after -S.");
+
+			i++;
+			if(sscanf(argv[i], "%d:%d", &level, &words_per_block) != 2 || level < 1 || level > 3 || words_per_block < 1)
+				bad_params("Invalid sector parameters.");
+			sector_words[level - 1] = words_per_block;
+		}
+		else if(streq(argv[i], "-C"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected parameters after -C.");
+
+			i++;
+			if(parse_partition(argv[i], &level, &partition) != 0)
+				bad_params("Invalid partitioning parameters.");
+			partitions[level] = partition;
+		}
+		else if(streq(argv[i], "--hot"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected parameters after --hot.");
+
+			i++;
+			if(parse_hot(argv[i], &hot_k, &hot_region_bits) != 0)
+				bad_params("Invalid hot spot parameters.");
+		}
+		else if(streq(argv[i], "--format"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected a trace format after --format.");
+
+			i++;
+			if(parse_trace_format(argv[i], &trace_format) != 0)
+				bad_params("Invalid trace format.");
+		}
+		else if(streq(argv[i], "-T"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected parameters after -T.");
+
+			i++;
+			if(parse_tlb(argv[i], &level, &tlb) != 0)
+				bad_params("Invalid TLB parameters.");
+			tlb_configure(level, &tlb);
+		}
+		else if(streq(argv[i], "--pages"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected page sizes after --pages.");
+
+			i++;
+			if(parse_pages(argv[i]) != 0)
+				bad_params("Invalid page sizes.");
+		}
+		else if(streq(argv[i], "--page-walk"))
+		{
+			page_walks = 1;
+		}
+		else if(streq(argv[i], "--compact"))
+		{
+			compact_runs = 1;
+		}
+		else if(streq(argv[i], "--check"))
+		{
+			check_accesses = 1;
+		}
+		else if(streq(argv[i], "--stats-out") || streq(argv[i], "--stats-json"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected a file name after --stats-out or --stats-json.");
+
+			if(streq(argv[i], "--stats-out"))
+				stats_out_path = argv[i + 1];
+			else
+				stats_json_path = argv[i + 1];
+			i++;
+		}
+		else if(streq(argv[i], "--set-misses"))
+		{
+			set_histograms = 1;
+		}
+		else if(streq(argv[i], "-L"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected parameters after -L.");
+
+			i++;
+			if(parse_timing(argv[i], &level, &timing) != 0)
+				bad_params("Invalid latency parameters.");
+			timing_configure(level, &timing);
+		}
+		else if(streq(argv[i], "-M"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected parameters after -M.");
+
+			i++;
+			if(parse_memory_timing(argv[i], &memory_timing) != 0)
+				bad_params("Invalid memory timing parameters.");
+			timing_configure_memory(&memory_timing);
+		}
+		else if(streq(argv[i], "--dram"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected parameters after --dram.");
+
+			i++;
+			if(parse_dram(argv[i], &dram) != 0)
+				bad_params("Invalid DRAM parameters.");
+			dram_setup(&dram);
+		}
+		else if(streq(argv[i], "--cores"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected number of cores after --cores.");
+
+			i++;
+			num_cores = atoi(argv[i]);
+			if(num_cores < 1 || num_cores > MAX_CORES)
+				bad_params("Invalid number of cores.");
+		}
+		else if(streq(argv[i], "--hugepages"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected thp or explicit after --hugepages.");
+
+			i++;
+			if(streq(argv[i], "thp"))
+				huge_pages = Huge_THP;
+			else if(streq(argv[i], "explicit"))
+				huge_pages = Huge_EXPLICIT;
+			else
+				bad_params("Invalid huge page mode.");
+		}
+		else if(streq(argv[i], "-W"))
+		{
+			if(i == (argc - 1))
+				bad_params("Expected workload after -W.");
+
+			i++;
+			if(parse_workload(argv[i], &workload_info) != 0)
+				bad_params("Invalid workload.");
+			have_workload = 1;
+		}
 		else
 		{
+			if(num_cores > 1 && argc - i == num_cores)
+			{
+				for(level = 0; level < num_cores; level++)
+				{
+					core_traces[level] = trace_open(argv[i + level], trace_format, num_cores);
+					if(core_traces[level] == NULL)
+						bad_params("Could not open trace file.");
+				}
+				break;
+			}
 			if(i != (argc - 1))
 				bad_params("Trace filename should be last argument.");
 
@@ -1014,7 +2677,101 @@ FILE* parse_arguments(int argc, char** argv)
 	if(have_data[2] && !have_data[1])
 		bad_params("L3 D-cache specified, but not L2.");
 
-	trace = fopen(argv[argc - 1], "r");
+	check_index(&icache_info);
+	for(i = 0; i < 3; i++)
+	{
+		if(have_data[i])
+			check_index(&dcache_info[i]);
+		if(dcache_info[i].index == Index_SKEW && (prefetch_info[i].kind != Prefetch_NONE || sector_words[i] != 0))
+			bad_params("Skewed D-cache levels can't have a prefetcher or sectors.");
+		if(partitions[i].kind != Partition_NONE)
+		{
+			int c, ways = dcache_info[i].associativity;
+			if(!have_data[i])
+				bad_params("Partitioning given for a D-cache level that isn't there.");
+			if(ways < 2 || ways > 64 || dcache_info[i].index == Index_SKEW)
+				bad_params("Partitioned levels need 2 to 64 ways and can't be skewed.");
+			if(partitions[i].kind == Partition_UCP && partitions[i].classes > ways)
+				bad_params("UCP needs at least one way per class.");
+			for(c = 0; c < partitions[i].classes; c++)
+			{
+				if(partitions[i].kind == Partition_CAT && (ways < 64 && (partitions[i].cls[c].mask & ((1UL << ways) - 1)) == 0))
+					bad_params("A CAT mask has none of the level's ways.");
+			}
+		}
+		if(prefetch_info[i].kind != Prefetch_NONE && !have_data[i])
+			bad_params("Prefetcher attached to a D-cache level that isn't there.");
+		if(victim_caches[i].info.kind != Victim_NONE && !have_data[i])
+			bad_params("Victim cache attached to a D-cache level that isn't there.");
+		if(write_buffers[i].info.entries != 0 && (!have_data[i] || dcache_info[i].write_scheme != Write_WRITE_THROUGH))
+			bad_params("Write buffers go on write-through D-cache levels.");
+		if(sector_words[i] != 0)
+		{
+			if(!have_data[i])
+				bad_params("Sectors given for a D-cache level that isn't there.");
+			if(power_of_two(sector_words[i]) < 0 || dcache_info[i].words_per_block % sector_words[i] != 0 ||
+				dcache_info[i].words_per_block / sector_words[i] > MAX_SECTORS)
+				bad_params("Sectors must be a power of two words that divides the block into at most 16.");
+			if(victim_caches[i].info.kind != Victim_NONE)
+				bad_params("A sectored level can't have a victim or miss cache.");
+		}
+	}
+
+	if(tlb_configured(TLB_L2) && !tlb_configured(TLB_I) && !tlb_configured(TLB_D))
+		bad_params("L2 TLB specified, but no I-TLB or D-TLB.");
+
+	if(dram_enabled && !timing_enabled)
+		bad_params("--dram runs on the timing model's clock; give -L or -M too.");
+
+	if(compact_runs && (num_cores > 1 || timing_enabled || tlb_enabled))
+		bad_params("--compact can't be used with --cores, timing or TLBs, which see every access.");
+
+	if((stats_out_path != NULL || stats_json_path != NULL) && num_cores > 1)
+		bad_params("Statistics can't be saved with --cores.");
+	if(set_histograms && stats_out_path == NULL && stats_json_path == NULL)
+		bad_params("--set-misses only goes into --stats-out or --stats-json files.");
+	if(set_histograms && (icache_info.index == Index_SKEW || dcache_info[0].index == Index_SKEW ||
+		dcache_info[1].index == Index_SKEW || dcache_info[2].index == Index_SKEW))
+		bad_params("--set-misses can't be used with skewed caches, whose ways each have their own set.");
+
+	if(check_accesses)
+	{
+		for(i = 0; i < 3; i++)
+		{
+			if(prefetch_info[i].kind != Prefetch_NONE || victim_caches[i].info.kind != Victim_NONE ||
+				write_buffers[i].info.entries != 0 || sector_words[i] != 0 ||
+				partitions[i].kind != Partition_NONE || dcache_info[i].index == Index_SKEW)
+				bad_params("--check only covers caches without prefetchers, victim caches, write buffers, sectors, partitions or skewing.");
+		}
+		if(icache_info.index == Index_SKEW || tlb_enabled || num_cores > 1)
+			bad_params("--check can't be used with a skewed I-cache, TLBs or --cores.");
+	}
+
+	if(num_cores > 1)
+	{
+		if(tlb_enabled)
+			bad_params("TLBs aren't supported with --cores.");
+		if(!have_data[0])
+			bad_params("--cores needs an L1 D-cache.");
+		if(dcache_info[0].words_per_block > 32)
+			bad_params("--cores tracks the words of an L1 block in 32 bits, so L1 blocks can be at most 32 words.");
+		if(timing_enabled)
+			bad_params("The timing model only supports one core.");
+		if(prefetch_info[0].kind != Prefetch_NONE || write_buffers[0].info.entries != 0 || sector_words[0] != 0 ||
+			victim_caches[0].info.kind != Victim_NONE)
+			bad_params("Prefetchers, victim caches, write buffers and sectors aren't supported on the private L1 with --cores.");
+		if(have_workload)
+			bad_params("--cores needs traces, not a workload.");
+		if(icache_info.index == Index_SKEW || dcache_info[0].index == Index_SKEW)
+			bad_params("The private caches can't be skewed with --cores.");
+		if(partitions[0].kind != Partition_NONE)
+			bad_params("Only the shared levels can be partitioned with --cores.");
+	}
+
+	if(have_workload || core_traces[0] != NULL)
+		return NULL;
+
+	trace = trace_open(argv[argc - 1], trace_format, num_cores);
 
 	if(trace == NULL)
 		bad_params("Could not open trace file.");
@@ -1022,17 +2779,122 @@ FILE* parse_arguments(int argc, char** argv)
 	return trace;
 }
 
+/* Writes the --stats-out and --stats-json files */
+static void save_stats(int argc, char** argv)
+{
+  SavedStats s;
+  int x, length = 0;
+
+  memset(&s, 0, sizeof(s));
+  for(x = 0; x < argc && length + strlen(argv[x]) + 2 < STATS_MAX_COMMAND; x++)
+    length += sprintf(s.command + length, "%s%s", x > 0 ? " " : "", argv[x]);
+  s.levels = num_dlevels;
+  s.shards = 1;
+  s.accesses = accesses_seen;
+  s.caches[0] = icache_info;
+  s.stats[0] = icache_stats;
+  s.sets[0] = set_misses[0] != NULL ? icache_setup.num_rows : 0;
+  s.set_misses[0] = set_misses[0];
+  for(x = 0; x < num_dlevels; x++)
+  {
+    s.caches[x + 1] = dcache_info[x];
+    s.stats[x + 1] = dcache_stats[x];
+    s.sets[x + 1] = set_misses[x + 1] != NULL ? dcache_setup[x].num_rows : 0;
+    s.set_misses[x + 1] = set_misses[x + 1];
+  }
+  if(stats_out_path != NULL && stats_write(stats_out_path, &s) != 0)
+    fprintf(stderr, "Could not write stats file %s.\n", stats_out_path);
+  if(stats_json_path != NULL && stats_write_json(stats_json_path, &s) != 0)
+    fprintf(stderr, "Could not write stats file %s.\n", stats_json_path);
+}
+/* Prints statistics read back by merge the way a run prints its own */
+void print_saved_stats(const SavedStats* s)
+{
+  int x;
+  printf("%d shard%s, %llu accesses: %s\n\n", s->shards, s->shards == 1 ? "" : "s", s->accesses, s->command);
+  icache_info = s->caches[0];
+  icache_stats = s->stats[0];
+  for(x = 0; x < 3; x++)
+  {
+    dcache_info[x] = s->caches[x + 1];
+    dcache_stats[x] = s->stats[x + 1];
+    if(x >= s->levels)
+      dcache_info[x].num_blocks = 0;
+  }
+  print_statistics();
+}
+
+/* Feeds the -W synthetic workload through the simulator */
+static void run_workload()
+{
+	Workload w;
+	static MemAccess batch[TRACE_BATCH];
+	int count;
+
+	workload_init(&w, &workload_info);
+	do
+	{
+		for(count = 0; count < TRACE_BATCH && workload_next(&w, &batch[count].type, &batch[count].address); count++)
+			;
+		handle_accesses(batch, count);
+	} while(count == TRACE_BATCH);
+	workload_free(&w);
+}
+
 int main(int argc, char** argv)
 {
-	FILE* trace = parse_arguments(argc, argv);
+	TraceReader* trace;
+	static MemAccess batch[TRACE_BATCH];
+	int count;
+
+	if(argc > 1 && streq(argv[1], "bench"))
+		return bench_main(argc - 1, argv + 1);
+	if(argc > 1 && streq(argv[1], "gen"))
+		return gen_main(argc - 1, argv + 1);
+	if(argc > 1 && streq(argv[1], "dse"))
+		return dse_main(argc - 1, argv + 1);
+	if(argc > 1 && streq(argv[1], "check"))
+		return check_main(argc - 1, argv + 1);
+	if(argc > 1 && streq(argv[1], "merge"))
+		return merge_main(argc - 1, argv + 1);
+
+	trace = parse_arguments(argc, argv);
 
 	setup_caches();
+	print_memory_use();
+	if(want_profile)
+		profile_start();
 
-	while(!feof(trace))
-		read_trace_line(trace);
+	if(core_traces[0] != NULL)
+		run_cores(core_traces, num_cores);
+	else if(trace == NULL)
+		run_workload();
+	else
+	{
+		do
+		{
+			for(count = 0; count < TRACE_BATCH && trace_read(trace, &batch[count]); count++)
+				;
+			handle_accesses(batch, count);
+		} while(count == TRACE_BATCH);
 
-	fclose(trace);
+		trace_close(trace);
+	}
 
+	drain_write_buffers();
 	print_statistics();
+	if(timing_enabled)
+		print_timing();
+	if(dram_enabled)
+		print_dram();
+	if(tlb_enabled)
+		print_tlb_stats();
+	if(hot_k)
+		print_hot_spots();
+	print_profile();
+	if(stats_out_path != NULL || stats_json_path != NULL)
+		save_stats(argc, argv);
+	if(check_accesses)
+		fprintf(stderr, "Checked %llu accesses against the reference model: no divergence.\n", checked);
 	return 0;
 }
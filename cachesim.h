@@ -30,6 +30,15 @@ typedef enum
 	Replacement_RANDOM,
 } ReplacementType;
 
+typedef enum
+{
+	Index_PLAIN,  /* the low bits of the block number */
+	Index_XOR,    /* all the block number's bits XOR-folded down */
+	Index_MOD,    /* block number modulo the number of sets */
+	Index_PRIME,  /* like MOD, with the set count cut down to a prime */
+	Index_SKEW,   /* a different hash for each way */
+} IndexType;
+
 typedef unsigned long addr_t;
 
 /*
@@ -59,6 +68,9 @@ write until we kick out the block.
 
 allocate_scheme can be Allocate_ALLOCATE or Allocate_NO_ALLOCATE. This is what
 happens when you write to the cache, and it's a miss.
+
+index is how a block picks its set. Only Index_PLAIN, the default, takes the set
+straight from address bits; the others store the whole block number as the tag.
 */
 
 typedef struct
@@ -69,41 +81,189 @@ typedef struct
 	ReplacementType replacement;
 	WriteScheme write_scheme;     /* D-cache only! */
 	AllocateType allocate_scheme; /* D-cache only! */
+	IndexType index;
 } CacheInfo;
 
-typedef struct
-{
-	short valid_bit;
-	short dirty_bit;	/* D-cache only! */
-	int LRU_age;	
-	unsigned int tag;
-} CacheBlock;
+/*
+Block metadata is packed into one 32-bit word: the tag sits above bit 2, and
+the low two bits are the valid and dirty (D-cache only!) bits. Tags are at most
+30 bits since 2 address bits are always byte select, so it always fits.
+
+LRU state isn't kept per block at all. Each set stores the recency rank of its
+ways (0 is most recently used) in ceil(log2(associativity)) bits per way, so a
+direct-mapped cache needs none. Ranks start out as 0, 1, 2... so the invalid
+ways always hold the highest ranks and the first invalid way is next in line.
+*/
+typedef unsigned int CacheBlock;
+
+#define BLOCK_VALID 0x1
+#define BLOCK_DIRTY 0x2
+#define BLOCK_TAG_SHIFT 2
 
 typedef struct
 {
 	int word_shift, row_shift, tag_shift;
 	int word_mask, row_mask, tag_mask;
 	int num_rows, num_cols;
+	int row_bits;
+	IndexType index;
 } CacheSetup;
 
+/* The metadata for one cache: num_rows * num_cols blocks stored row by row,
+and lru_bytes of packed LRU ranks per row. Both point into the metadata
+arena, as do the prefetched bitmap when the level has a prefetcher and the
+sector bits and last-use stamps of sectored and skewed caches. */
+typedef struct
+{
+	CacheBlock* blocks;
+	unsigned char* lru;
+	unsigned char* prefetched; /* one bit per block, only with a prefetcher */
+	unsigned int* sectors;     /* per-sector valid and dirty bits, only if sectored */
+	unsigned long* stamps;     /* when each block was last used, only if skewed */
+	int num_cols;
+	int lru_bits, lru_bytes;
+	unsigned int lru_mask;
+} CacheArray;
+
+static inline CacheBlock* block_at(CacheArray* c, int row, int col)
+{
+	return &c->blocks[(unsigned long)row * c->num_cols + col];
+}
+static inline int block_valid(CacheArray* c, int row, int col)
+{
+	return (*block_at(c, row, col) & BLOCK_VALID) != 0;
+}
+static inline int block_dirty(CacheArray* c, int row, int col)
+{
+	return (*block_at(c, row, col) & BLOCK_DIRTY) != 0;
+}
+static inline unsigned int block_tag(CacheArray* c, int row, int col)
+{
+	return *block_at(c, row, col) >> BLOCK_TAG_SHIFT;
+}
+static inline int block_prefetched(CacheArray* c, int row, int col)
+{
+	unsigned long i = (unsigned long)row * c->num_cols + col;
+	return c->prefetched != 0 && (c->prefetched[i / 8] >> (i % 8)) & 1;
+}
+static inline void set_prefetched(CacheArray* c, int row, int col, int prefetched)
+{
+	unsigned long i = (unsigned long)row * c->num_cols + col;
+	if(prefetched)
+		c->prefetched[i / 8] |= 1 << (i % 8);
+	else
+		c->prefetched[i / 8] &= ~(1 << (i % 8));
+}
+/* A sectored block has a valid bit per sector in the low half of its word
+and a dirty bit per sector in the high half, so up to 16 sectors */
+#define SECTOR_DIRTY_SHIFT 16
+#define MAX_SECTORS 16
+static inline unsigned int* block_sectors(CacheArray* c, int row, int col)
+{
+	return &c->sectors[(unsigned long)row * c->num_cols + col];
+}
+/* A new tag means a new block, which wasn't brought in by a prefetch unless
+the prefetcher marks it afterwards, and has none of its sectors yet */
+static inline void set_tag(CacheArray* c, int row, int col, unsigned int tag)
+{
+	CacheBlock* b = block_at(c, row, col);
+	*b = (tag << BLOCK_TAG_SHIFT) | (*b & (BLOCK_VALID | BLOCK_DIRTY));
+	if(c->prefetched != 0)
+		set_prefetched(c, row, col, 0);
+	if(c->sectors != 0)
+		*block_sectors(c, row, col) = 0;
+}
+static inline void set_dirty(CacheArray* c, int row, int col, int dirty)
+{
+	CacheBlock* b = block_at(c, row, col);
+	*b = dirty ? (*b | BLOCK_DIRTY) : (*b & ~BLOCK_DIRTY);
+}
+static inline void set_valid(CacheArray* c, int row, int col)
+{
+	*block_at(c, row, col) |= BLOCK_VALID;
+}
+static inline void clear_block(CacheArray* c, int row, int col)
+{
+	*block_at(c, row, col) = 0;
+	if(c->prefetched != 0)
+		set_prefetched(c, row, col, 0);
+	if(c->sectors != 0)
+		*block_sectors(c, row, col) = 0;
+}
+/* Ranks are read and written a byte at a time so they can straddle bytes and
+the layout doesn't depend on host endianness. lru_bytes has 3 bytes of slack
+at the end of the array for the last set. */
+static inline unsigned int lru_rank(CacheArray* c, int row, int col)
+{
+	unsigned long bit = (unsigned long)col * c->lru_bits;
+	unsigned char* p = c->lru + (unsigned long)row * c->lru_bytes + bit / 8;
+	unsigned int word = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+	return (word >> (bit % 8)) & c->lru_mask;
+}
+static inline void set_lru_rank(CacheArray* c, int row, int col, unsigned int rank)
+{
+	unsigned long bit = (unsigned long)col * c->lru_bits;
+	unsigned char* p = c->lru + (unsigned long)row * c->lru_bytes + bit / 8;
+	unsigned int word = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+	word = (word & ~(c->lru_mask << (bit % 8))) | (rank << (bit % 8));
+	p[0] = word;
+	p[1] = word >> 8;
+	p[2] = word >> 16;
+	p[3] = word >> 24;
+}
+
+/* 64-bit so that long runs, and the sums of many shards that merge adds up,
+can't overflow them */
 typedef struct
 {
-	int num_reads, words_read_mem, num_writes, words_write_mem;
-	int compulsory_reads, conflict_reads, capacity_reads;
-	int compulsory_writes, conflict_writes, capacity_writes;
-	int total_misses;
+	long long num_reads, words_read_mem, num_writes, words_write_mem;
+	long long compulsory_reads, conflict_reads, capacity_reads;
+	long long compulsory_writes, conflict_writes, capacity_writes;
+	long long total_misses;
 	double miss_rate;
 
 } CacheStats;
 
+/* One access from a trace or workload, for the batched handle_accesses() */
+typedef struct
+{
+	AccessType type;
+	addr_t address;
+	int core;       /* only looked at with --cores */
+} MemAccess;
+
+/* How many accesses ahead handle_accesses() prefetches set metadata */
+#define BATCH_PREFETCH_DISTANCE 8
+
+/* What a level's prefetcher did. Filled prefetches go through the normal read
+path, so their traffic is included in that level's words_read_mem and
+words_write_mem as well as counted here. */
+typedef struct
+{
+	long long issued;     /* queued to be fetched */
+	long long filled;     /* actually brought into the cache */
+	long long useful;     /* filled and then hit by a demand access */
+	long long late;       /* demand missed while the prefetch was still in flight */
+	long long polluting;  /* demand missed on a block a prefetch had evicted */
+	long long redundant;  /* already cached or in flight when issued or filled */
+	long long dropped;    /* the prefetch queue was full */
+	long long words_read_mem, words_write_mem;
+} PrefetchStats;
+
 void dump_cache_info();
+void setup_caches();
+void print_memory_use();
+void configure_caches(CacheInfo icache, CacheInfo* dcaches, int levels);
+void get_cache_stats(CacheStats* istats, CacheStats* dstats);
+void handle_access(AccessType type, addr_t address);
+void handle_accesses(const MemAccess* accesses, int count);
 int power_of_two(int);
 void updateAge(int);
-void updateAgeD(int col, int level, CacheBlock** cache);
+void updateAgeD(int col, int level, CacheArray* cache);
 void setup_cache(CacheInfo i, CacheSetup* s);
 void accessI(addr_t address);
-void accessD_Read(addr_t address, int level, CacheBlock** cache);
-void accessD_Write(addr_t address, int level, CacheBlock** cache);
+void accessD_Read(addr_t address, int level, CacheArray* cache);
+void accessD_Write(addr_t address, int level, CacheArray* cache);
 
 
 #endif
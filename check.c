@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "check.h"
+
+/*
+Usage:
+	./cachesim check [-r runs] [-n accesses] [-s seed]
+
+Cross-checks the simulator against its reference model (see refmodel.h) on
+random hierarchies and workloads. Each run picks an I-cache and one to three
+D-cache levels with random geometry, index function, replacement, write and
+allocate schemes, and a random workload over a footprint small enough that
+the sets fill up and evict, and simulates it with --check (and --compact
+half the time) in a child process. The first run that diverges stops the
+search: its report is printed along with the command line that reproduces it.
+
+	-r  runs (default 200)
+	-n  accesses per run (default 100000)
+	-s  seed for the random choices (default 1)
+
+Exits 0 if every run agreed with the reference and 1 otherwise.
+*/
+
+#define CHECK_MAX_ARGS 16
+#define CHECK_ARG_SIZE 96
+#define CHECK_REPORT_SIZE 65536
+
+static unsigned long long rng;
+
+static unsigned long next_random()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng >> 11;
+}
+/* A random number from lo to hi inclusive */
+static int pick(int lo, int hi)
+{
+  return lo + next_random() % (hi - lo + 1);
+}
+
+/* Writes the -I or -D parameters of a random cache to buf. level is 0 for
+  the I-cache. */
+static void random_cache(char* buf, int level)
+{
+  static const char* indexes[] = { "plain", "xor", "mod", "prime" };
+  int index = pick(0, 3);
+  int assoc = pick(1, 16);
+  int sets = index < 2 ? 1 << pick(0, 7) : pick(1, 200);
+  int words = 1 << pick(0, 4);
+  char replace = pick(0, 1) ? 'L' : 'R';
+
+  if(level == 0)
+    sprintf(buf, "%d:%d:%d:%c:%s", sets * assoc, words, assoc, replace, indexes[index]);
+  else
+    sprintf(buf, "%d:%d:%d:%d:%c:%c:%c:%s", level, sets * assoc, words, assoc, replace,
+      pick(0, 1) ? 'B' : 'T', pick(0, 1) ? 'A' : 'N', indexes[index]);
+}
+static void random_workload(char* buf, unsigned long accesses)
+{
+  static const char* kinds[] = { "seq", "stride", "random", "zipf", "chase", "mixed" };
+  static const char* reads[] = { "0.5", "0.7", "0.9", "1.0" };
+  int kind = pick(0, 5);
+
+  sprintf(buf, "%s:footprint=%d:reads=%s:n=%lu:seed=%d", kinds[kind], 1 << pick(10, 18),
+    reads[pick(0, 3)], accesses, pick(1, 1000000));
+  if(kind == 1 || kind == 4)
+    sprintf(buf + strlen(buf), ":stride=%d", 4 << pick(0, 6));
+}
+
+/* Runs the simulator on args with its stdout thrown away, collecting what it
+  says on stderr into report. Returns whether it exited cleanly. */
+static int run_child(char** args, char* report)
+{
+  int fds[2], status, got = 0, n;
+  pid_t pid;
+
+  if(pipe(fds) < 0)
+    return 0;
+  fflush(stdout);
+  fflush(stderr);
+  pid = fork();
+  if(pid == 0)
+  {
+    close(fds[0]);
+    dup2(open("/dev/null", O_WRONLY), 1);
+    dup2(fds[1], 2);
+    execv("/proc/self/exe", args);
+    _exit(127);
+  }
+  close(fds[1]);
+  if(pid < 0)
+  {
+    close(fds[0]);
+    return 0;
+  }
+  while(got < CHECK_REPORT_SIZE - 1 && (n = read(fds[0], report + got, CHECK_REPORT_SIZE - 1 - got)) > 0)
+    got += n;
+  report[got] = '\0';
+  close(fds[0]);
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int check_main(int argc, char** argv)
+{
+  static char strings[CHECK_MAX_ARGS][CHECK_ARG_SIZE];
+  static char report[CHECK_REPORT_SIZE];
+  char* args[CHECK_MAX_ARGS + 1];
+  unsigned long accesses = 100000;
+  int runs = 200, seed = 1, run, levels, num_args, i;
+
+  for(i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+      runs = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      accesses = strtoul(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+      seed = atoi(argv[++i]);
+    else
+    {
+      fprintf(stderr, "Unknown or invalid check option %s.\n", argv[i]);
+      return 1;
+    }
+  }
+  if(runs < 1 || accesses < 1)
+  {
+    fprintf(stderr, "Invalid check parameters.\n");
+    return 1;
+  }
+  rng = 0x9e3779b97f4a7c15ULL * (unsigned long long)(seed + 1);
+
+  for(run = 0; run < runs; run++)
+  {
+    num_args = 0;
+    args[num_args++] = "./cachesim";
+    args[num_args++] = "--check";
+    if(pick(0, 1))
+      args[num_args++] = "--compact";
+    args[num_args++] = "-I";
+    random_cache(strings[num_args], 0);
+    args[num_args] = strings[num_args];
+    num_args++;
+    levels = pick(1, 3);
+    for(i = 1; i <= levels; i++)
+    {
+      args[num_args++] = "-D";
+      random_cache(strings[num_args], i);
+      args[num_args] = strings[num_args];
+      num_args++;
+    }
+    args[num_args++] = "-W";
+    random_workload(strings[num_args], accesses);
+    args[num_args] = strings[num_args];
+    num_args++;
+    args[num_args] = NULL;
+
+    if(!run_child(args, report))
+    {
+      fputs(report, stderr);
+      fprintf(stderr, "Run %d of %d failed. To reproduce:\n\t", run + 1, runs);
+      for(i = 0; i < num_args; i++)
+        fprintf(stderr, "%s%c", args[i], i == num_args - 1 ? '\n' : ' ');
+      return 1;
+    }
+  }
+  printf("%d random runs of %lu accesses agreed with the reference model.\n", runs, accesses);
+  return 0;
+}
@@ -0,0 +1,8 @@
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+/* cachesim check - runs --check on random hierarchies and workloads until one
+diverges from the reference model. See check.c for the options. */
+int check_main(int argc, char** argv);
+
+#endif
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "coherence.h"
+
+CoherenceStats coherence_stats[MAX_CORES];
+
+/* Open addressing with linear probing, kept at most half full */
+static DirEntry* directory;
+static unsigned long directory_size, directory_used;
+
+static unsigned long hash_block(unsigned long block)
+{
+  block ^= block >> 33;
+  block *= 0xff51afd7ed558ccdUL;
+  block ^= block >> 33;
+  return block;
+}
+static DirEntry* probe(DirEntry* table, unsigned long size, unsigned long key)
+{
+  unsigned long i = hash_block(key) & (size - 1);
+  while(table[i].block != 0 && table[i].block != key)
+    i = (i + 1) & (size - 1);
+  return &table[i];
+}
+static void grow()
+{
+  unsigned long old_size = directory_size, i;
+  DirEntry* old = directory;
+
+  directory_size = old_size ? old_size * 2 : 4096;
+  directory = calloc(directory_size, sizeof(DirEntry));
+  if(directory == NULL)
+  {
+    fprintf(stderr, "Out of memory for the coherence directory.\n");
+    exit(1);
+  }
+  for(i = 0; i < old_size; i++)
+  {
+    if(old[i].block != 0)
+      *probe(directory, directory_size, old[i].block) = old[i];
+  }
+  free(old);
+}
+
+/* Returns the directory entry for an L1 block, adding an empty one if it
+  isn't tracked yet */
+DirEntry* directory_find(unsigned long block)
+{
+  DirEntry* e;
+  if(2 * (directory_used + 1) > directory_size)
+    grow();
+  e = probe(directory, directory_size, block + 1);
+  if(e->block == 0)
+  {
+    e->block = block + 1;
+    e->owner = -1;
+    directory_used++;
+  }
+  return e;
+}
+
+void print_coherence_stats(int core)
+{
+  CoherenceStats* s = &coherence_stats[core];
+  printf("\tCoherence:\n");
+  printf("\t\tCoherence misses: %llu\n", s->coherence_misses);
+  printf("\t\tInvalidations received: %llu\n\t\tFalse sharing invalidations: %llu\n", s->invalidations, s->false_sharing);
+  printf("\t\tInterventions (Modified copies pulled back): %llu\n", s->interventions);
+  printf("\t\tUpgrades (Shared to Modified): %llu\n", s->upgrades);
+}
+
+/* Prints the top blocks by false sharing invalidations. block_shift turns an
+  L1 block number back into an address. */
+void print_false_sharing(int block_shift, int top)
+{
+  DirEntry** best = calloc(top, sizeof(DirEntry*));
+  unsigned long i;
+  int j, k, shown = 0;
+
+  for(i = 0; i < directory_size; i++)
+  {
+    DirEntry* e = &directory[i];
+    if(e->block == 0 || e->false_sharing == 0)
+      continue;
+    for(j = shown; j > 0 && best[j - 1]->false_sharing < e->false_sharing; j--)
+      ;
+    if(j >= top)
+      continue;
+    for(k = (shown < top ? shown : top - 1); k > j; k--)
+      best[k] = best[k - 1];
+    best[j] = e;
+    if(shown < top)
+      shown++;
+  }
+
+  printf("\n\nFalse sharing hot blocks:\n");
+  if(shown == 0)
+    printf("\tNone\n");
+  for(j = 0; j < shown; j++)
+  {
+    printf("\t0x%08lx: %u false sharing of %u invalidations\n",
+      (best[j]->block - 1) << block_shift, best[j]->false_sharing, best[j]->invalidations);
+  }
+  free(best);
+}
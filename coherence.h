@@ -0,0 +1,52 @@
+#ifndef _COHERENCE_H_
+#define _COHERENCE_H_
+
+/* Multi-core mode, turned on with
+	--cores <n>
+gives each of up to MAX_CORES cores its own I-cache and L1 D-cache; L2 and
+L3 are shared. Accesses come either from one trace whose lines carry a third
+column with the core number
+	0x00001000 R 2
+or from one trace file per core, given in core order in place of the single
+trace. Per-core traces are read on their own threads an epoch of accesses at
+a time and interleaved one access per core in core order, so the result never
+depends on thread scheduling.
+
+The L1 D-caches are kept coherent with MESI under a directory that tracks
+which cores may hold each L1 block. A block dirty in an L1 is Modified; a
+clean one is Exclusive if no other core holds it and Shared otherwise. A read
+of a block another core has Modified makes that core write it back and drop
+to Shared; a write invalidates every other copy, writing back a Modified one.
+Sharers are checked against the L1s lazily, so silent clean evictions are
+allowed. */
+
+#define MAX_CORES 16
+
+typedef struct
+{
+	unsigned long block;         /* L1 block number + 1; 0 marks a free slot */
+	unsigned short sharers;      /* cores that may hold a copy */
+	unsigned short lost;         /* cores whose copy a write invalidated */
+	signed char owner;           /* core holding it Modified, or -1 */
+	unsigned int words[MAX_CORES]; /* words each core touched since it got its copy, so L1
+	                                  blocks are at most 32 words with --cores */
+	unsigned int invalidations;
+	unsigned int false_sharing;  /* invalidations of copies that never touched the written word */
+} DirEntry;
+
+typedef struct
+{
+	unsigned long long coherence_misses;  /* L1 misses on a block a write invalidated */
+	unsigned long long invalidations;     /* copies this core lost to other cores' writes */
+	unsigned long long false_sharing;     /* of those, ones for words it never touched */
+	unsigned long long interventions;     /* Modified copies this core's reads pulled back */
+	unsigned long long upgrades;          /* writes to a Shared copy that invalidated others */
+} CoherenceStats;
+
+extern CoherenceStats coherence_stats[MAX_CORES];
+
+DirEntry* directory_find(unsigned long block);
+void print_coherence_stats(int core);
+void print_false_sharing(int block_shift, int top);
+
+#endif
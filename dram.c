@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dram.h"
+
+typedef struct
+{
+	long open_row;                /* -1 if the bank is precharged */
+	unsigned long long ready;     /* cycle the bank can take a new command */
+} DramBank;
+
+typedef struct
+{
+	unsigned long long reads, writes;
+	unsigned long long words_read, words_written;
+	unsigned long long row_hits, row_empty, row_conflicts;
+	unsigned long long bank_wait_cycles;  /* waiting for a busy bank */
+	unsigned long long bus_wait_cycles;   /* waiting for the channel's bus */
+	unsigned long long read_latency;      /* arrival to last word, reads only */
+	unsigned long long first, last;       /* first arrival, last completion */
+} DramStats;
+
+int dram_enabled;
+
+static DramInfo dram_info;
+static DramStats dram_stats;
+static DramBank* dram_banks;
+static double* bus_free;
+static unsigned long long* channel_requests;
+static int column_bits, channel_bits, rank_bits, bank_bits;
+
+static const char* policy_names[] = { "open", "closed" };
+static const char* mapping_names[] = { "row", "line", "xor" };
+
+static int log2_of(int n)
+{
+  int bits = 0;
+  while((1 << bits) < n)
+    bits++;
+  return bits;
+}
+static int is_power_of_two(int n)
+{
+  return n > 0 && (n & (n - 1)) == 0;
+}
+
+/* Parses "channels=2:banks=16:policy=closed" into info. Returns 0 on success. */
+int parse_dram(const char* spec, DramInfo* info)
+{
+  char buf[256];
+  char* item;
+  char* value;
+
+  if(strlen(spec) >= sizeof(buf))
+    return -1;
+  strcpy(buf, spec);
+
+  *info = (DramInfo){ 1, 1, 8, 8192, Dram_OPEN, Dram_MAP_ROW, 40, 40, 40, 2.0 };
+  for(item = strtok(buf, ":"); item != NULL; item = strtok(NULL, ":"))
+  {
+    value = strchr(item, '=');
+    if(value == NULL)
+      return -1;
+    *value++ = '\0';
+    if(strcmp(item, "channels") == 0)
+      info->channels = atoi(value);
+    else if(strcmp(item, "ranks") == 0)
+      info->ranks = atoi(value);
+    else if(strcmp(item, "banks") == 0)
+      info->banks = atoi(value);
+    else if(strcmp(item, "row") == 0)
+      info->row_bytes = atoi(value);
+    else if(strcmp(item, "cl") == 0)
+      info->cl = atoi(value);
+    else if(strcmp(item, "rcd") == 0)
+      info->rcd = atoi(value);
+    else if(strcmp(item, "rp") == 0)
+      info->rp = atoi(value);
+    else if(strcmp(item, "bus") == 0)
+      info->words_per_cycle = atof(value);
+    else if(strcmp(item, "policy") == 0)
+    {
+      if(strcmp(value, "open") == 0)
+        info->policy = Dram_OPEN;
+      else if(strcmp(value, "closed") == 0)
+        info->policy = Dram_CLOSED;
+      else
+        return -1;
+    }
+    else if(strcmp(item, "map") == 0)
+    {
+      if(strcmp(value, "row") == 0)
+        info->mapping = Dram_MAP_ROW;
+      else if(strcmp(value, "line") == 0)
+        info->mapping = Dram_MAP_LINE;
+      else if(strcmp(value, "xor") == 0)
+        info->mapping = Dram_MAP_XOR;
+      else
+        return -1;
+    }
+    else
+      return -1;
+  }
+
+  if(!is_power_of_two(info->channels) || !is_power_of_two(info->ranks) || !is_power_of_two(info->banks))
+    return -1;
+  if(!is_power_of_two(info->row_bytes) || info->row_bytes < 64)
+    return -1;
+  if(info->cl < 0 || info->rcd < 0 || info->rp < 0 || info->words_per_cycle <= 0)
+    return -1;
+  return 0;
+}
+
+void dram_setup(const DramInfo* info)
+{
+  int i;
+  dram_info = *info;
+  dram_enabled = 1;
+  column_bits = log2_of(info->row_bytes);
+  channel_bits = log2_of(info->channels);
+  rank_bits = log2_of(info->ranks);
+  bank_bits = log2_of(info->banks);
+
+  dram_banks = malloc(sizeof(DramBank) * info->channels * info->ranks * info->banks);
+  bus_free = calloc(info->channels, sizeof(double));
+  channel_requests = calloc(info->channels, sizeof(unsigned long long));
+  for(i = 0; i < info->channels * info->ranks * info->banks; i++)
+  {
+    dram_banks[i].open_row = -1;
+    dram_banks[i].ready = 0;
+  }
+}
+
+/* Splits a byte address into channel, bank (numbered across the channel's
+  ranks) and row */
+static void map_address(addr_t address, int* channel, int* bank, long* row)
+{
+  int rank;
+  if(dram_info.mapping == Dram_MAP_LINE)
+  {
+    address >>= 6;
+    *channel = address & (dram_info.channels - 1);
+    address >>= channel_bits;
+    *bank = address & (dram_info.banks - 1);
+    address >>= bank_bits;
+    rank = address & (dram_info.ranks - 1);
+    address >>= rank_bits;
+    address >>= column_bits - 6;
+  }
+  else
+  {
+    address >>= column_bits;
+    *channel = address & (dram_info.channels - 1);
+    address >>= channel_bits;
+    *bank = address & (dram_info.banks - 1);
+    address >>= bank_bits;
+    rank = address & (dram_info.ranks - 1);
+    address >>= rank_bits;
+  }
+  *row = (long)address;
+  if(dram_info.mapping == Dram_MAP_XOR)
+    *bank ^= *row & (dram_info.banks - 1);
+  *bank += rank * dram_info.banks;
+}
+
+/* Serves words to or from address arriving at cycle t and returns the cycle
+  the last word is transferred */
+unsigned long long dram_access(unsigned long long t, addr_t address, int is_write, int words)
+{
+  int channel, bank;
+  long row;
+  DramBank* b;
+  unsigned long long start, latency;
+  double data_start, done;
+  unsigned long long finish;
+
+  map_address(address, &channel, &bank, &row);
+  b = &dram_banks[channel * dram_info.ranks * dram_info.banks + bank];
+  channel_requests[channel]++;
+
+  start = t > b->ready ? t : b->ready;
+  dram_stats.bank_wait_cycles += start - t;
+  if(b->open_row == row)
+  {
+    dram_stats.row_hits++;
+    latency = dram_info.cl;
+  }
+  else if(b->open_row < 0)
+  {
+    dram_stats.row_empty++;
+    latency = dram_info.rcd + dram_info.cl;
+  }
+  else
+  {
+    dram_stats.row_conflicts++;
+    latency = dram_info.rp + dram_info.rcd + dram_info.cl;
+  }
+
+  data_start = start + latency;
+  if(bus_free[channel] > data_start)
+  {
+    dram_stats.bus_wait_cycles += (unsigned long long)(bus_free[channel] - data_start);
+    data_start = bus_free[channel];
+  }
+  done = data_start + words / dram_info.words_per_cycle;
+  bus_free[channel] = done;
+  finish = (unsigned long long)(done + 0.999);
+
+  /* Column commands to an open row pipeline behind each other on the bus; a
+    closed-page bank precharges once the burst is over */
+  if(dram_info.policy == Dram_OPEN)
+  {
+    b->open_row = row;
+    b->ready = start + (latency - dram_info.cl);
+  }
+  else
+  {
+    b->open_row = -1;
+    b->ready = finish + dram_info.rp;
+  }
+
+  if(dram_stats.reads + dram_stats.writes == 0)
+    dram_stats.first = t;
+  if(is_write)
+  {
+    dram_stats.writes++;
+    dram_stats.words_written += words;
+  }
+  else
+  {
+    dram_stats.reads++;
+    dram_stats.words_read += words;
+    dram_stats.read_latency += finish - t;
+  }
+  if(finish > dram_stats.last)
+    dram_stats.last = finish;
+  return finish;
+}
+
+void print_dram()
+{
+  unsigned long long requests = dram_stats.reads + dram_stats.writes;
+  unsigned long long span = dram_stats.last - dram_stats.first;
+  double peak = dram_info.words_per_cycle * dram_info.channels;
+  int c;
+
+  printf("\n\nDRAM:\n");
+  printf("\t%d channel(s), %d rank(s), %d banks, %d-byte rows, %s page, %s mapping\n",
+    dram_info.channels, dram_info.ranks, dram_info.banks, dram_info.row_bytes,
+    policy_names[dram_info.policy], mapping_names[dram_info.mapping]);
+  printf("\tReads: %llu (%llu words)\n\tWrites: %llu (%llu words)\n",
+    dram_stats.reads, dram_stats.words_read, dram_stats.writes, dram_stats.words_written);
+  if(requests == 0)
+    return;
+  printf("\tRow buffer hits: %llu (%.2f%%)\n", dram_stats.row_hits, 100.0 * dram_stats.row_hits / requests);
+  printf("\tRow buffer misses (bank closed): %llu\n", dram_stats.row_empty);
+  printf("\tRow buffer conflicts: %llu (%.2f%%)\n", dram_stats.row_conflicts, 100.0 * dram_stats.row_conflicts / requests);
+  printf("\tBank busy wait: %llu cycles\n\tBus wait: %llu cycles\n", dram_stats.bank_wait_cycles, dram_stats.bus_wait_cycles);
+  printf("\tAverage read latency: %.2f cycles\n", dram_stats.reads ? (double)dram_stats.read_latency / dram_stats.reads : 0.0);
+  printf("\tEffective bandwidth: %.3f words/cycle (%.1f%% of peak)\n",
+    span ? (double)(dram_stats.words_read + dram_stats.words_written) / span : 0.0,
+    span ? 100.0 * (dram_stats.words_read + dram_stats.words_written) / span / peak : 0.0);
+  if(dram_info.channels > 1)
+  {
+    for(c = 0; c < dram_info.channels; c++)
+      printf("\tChannel %d requests: %llu\n", c, channel_requests[c]);
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef _DRAM_H_
+#define _DRAM_H_
+
+#include "cachesim.h"
+
+/* Main memory model for the traffic leaving the last D-cache level, turned on
+with
+	--dram <setting>=<value>[:<setting>=<value>...]
+
+Settings (all counts must be powers of two):
+	channels  independent channels, each with its own data bus (default 1)
+	ranks     ranks per channel (default 1)
+	banks     banks per rank (default 8)
+	row       row buffer size in bytes (default 8192)
+	policy    open: leave the row open after an access (default)
+	          closed: precharge right after every access
+	map       how an address is split up, most significant part first:
+	          row    row:rank:bank:channel:column, whole rows contiguous (default)
+	          line   row:column:rank:bank:channel:64-byte offset, consecutive
+	                 64-byte chunks spread over channels and then banks
+	          xor    like row, but the bank is XORed with the low row bits so
+	                 rows that map to the same bank spread out
+	cl, rcd, rp  CAS, activate and precharge latencies in cycles (default 40)
+	bus       words per cycle a channel's data bus moves (default 2)
+
+An access to the open row costs cl; to a closed bank rcd + cl; and to a bank
+with a different row open (a row conflict) rp + rcd + cl. It then waits for
+the channel's bus. Cycles are core cycles on the timing model's clock, so
+--dram needs -L or -M. */
+
+typedef enum
+{
+	Dram_OPEN,
+	Dram_CLOSED,
+} DramPolicy;
+
+typedef enum
+{
+	Dram_MAP_ROW,
+	Dram_MAP_LINE,
+	Dram_MAP_XOR,
+} DramMapping;
+
+typedef struct
+{
+	int channels;
+	int ranks;
+	int banks;
+	int row_bytes;
+	DramPolicy policy;
+	DramMapping mapping;
+	int cl, rcd, rp;
+	double words_per_cycle;
+} DramInfo;
+
+extern int dram_enabled;
+
+int parse_dram(const char* spec, DramInfo* info);
+void dram_setup(const DramInfo* info);
+unsigned long long dram_access(unsigned long long t, addr_t address, int is_write, int words);
+void print_dram();
+
+#endif
@@ -0,0 +1,694 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "cachesim.h"
+#include "workload.h"
+#include "trace.h"
+#include "dse.h"
+
+/*
+Usage:
+	./cachesim dse [-j jobs] [-n accesses] [-c bytes] [-a bits] [-h latencies] [-m latency]
+		-D <level>:<blocks>:<words>:<assoc>:<repl>:<write>:<alloc>... <trace> | -W <workload>
+
+Tries every D-cache hierarchy the -D ranges allow and prints the ones on the
+Pareto front: those no other candidate beats on one of size, miss rate, AMAT
+and memory traffic while being at least as good on the rest.
+
+-D takes the fields of the simulator's -D option, but each numeric field is a
+comma separated list of values and power-of-two ranges (256-4096 is 256, 512,
+1024, 2048 and 4096) and each letter field a list like L,R. Give one -D per
+level, from level 1 down.
+
+	-j  candidates simulated at once (default: one per CPU)
+	-n  data accesses to use from the trace, or to generate from the workload
+	-c  capacity budget in data bytes over all levels (K and M suffixes work)
+	-a  area budget in bits of data, tags, valid, dirty and LRU state
+	-h  comma separated hit latencies of levels 1 to 3 (default 2,10,30)
+	-m  memory latency (default 100)
+
+The data accesses are read once and each candidate is simulated on them in
+its own child process. The I-cache isn't explored. A candidate needs power of
+two block sizes and set counts, more capacity at each level than the one above
+and no write-back, no-allocate level. For each one:
+	miss_rate  data accesses that miss every level, as the product of the
+	           levels' local miss rates over reads and writes
+	amat       h1 + m1 * (h2 + m2 * (h3 + m3 * memory)), m the local miss rates
+	traffic    words to and from memory per data access
+
+Candidates run smallest first. Those that differ only in the associativity
+of an LRU, write-allocate last level, at the same number of sets, form a chain
+that grows in capacity. By the LRU stack property the last level can only
+miss less as it gains ways, and the levels above it don't change. So once a
+member of a chain evicts nothing from its last level, the bigger members are
+no better on any measure, and they are pruned without being simulated.
+
+Output is one JSON object per front member, smallest first, with the -D
+options that reproduce it. A summary goes to stderr.
+*/
+
+#define DSE_VERSION 1
+#define DSE_CHUNK 4096
+#define DSE_MAX_LIST 32
+#define DSE_MAX_JOBS 256
+#define DSE_MAX_COMBINATIONS 10000000UL
+#define DSE_MAX_CANDIDATES 20000
+#define DSE_KEY_ITEMS 18
+
+typedef struct
+{
+  int blocks[DSE_MAX_LIST], words[DSE_MAX_LIST], assocs[DSE_MAX_LIST];
+  int num_blocks, num_words, num_assocs;
+  int replacements, write_schemes, allocate_schemes;  /* one bit per enum value */
+} LevelRange;
+
+typedef enum
+{
+  Candidate_WAITING,
+  Candidate_DONE,
+  Candidate_PRUNED,
+  Candidate_FAILED,
+} CandidateState;
+
+typedef struct
+{
+  CacheInfo levels[3];
+  unsigned long size, area;
+  int chain;              /* -1 if it isn't in a chain */
+  CandidateState state;
+  double miss_rate, amat, traffic;
+} Candidate;
+
+typedef struct
+{
+  pid_t pid;
+  int fd;
+  Candidate* candidate;
+} Job;
+
+static int num_levels;
+static LevelRange ranges[3];
+static Candidate* candidates;
+static int num_candidates;
+static MemAccess* accesses;
+static int num_accesses;
+static int hit_latency[3] = { 2, 10, 30 };
+static int mem_latency = 100;
+
+/* Parses "1,2,8-32" into list, a range standing for the powers of two in
+  it. Returns how many values there were, 0 if the list is bad. */
+static int parse_values(const char* s, int* list)
+{
+  long lo, hi, p;
+  char* end;
+  int n = 0;
+  while(1)
+  {
+    lo = strtol(s, &end, 10);
+    if(end == s || lo <= 0)
+      return 0;
+    if(*end == '-')
+    {
+      s = end + 1;
+      hi = strtol(s, &end, 10);
+      if(end == s || hi < lo || hi > INT_MAX)
+        return 0;
+      for(p = 1; p < lo; p *= 2)
+        ;
+      for(; p <= hi; p *= 2)
+      {
+        if(n == DSE_MAX_LIST)
+          return 0;
+        list[n++] = p;
+      }
+    }
+    else
+    {
+      if(n == DSE_MAX_LIST)
+        return 0;
+      list[n++] = lo;
+    }
+    if(*end == '\0')
+      return n;
+    if(*end != ',')
+      return 0;
+    s = end + 1;
+  }
+}
+/* Parses a list like "L,R" into a bit per letter of letters */
+static int parse_letters(const char* s, const char* letters)
+{
+  const char* l;
+  int bits = 0;
+  while(*s != '\0')
+  {
+    if((l = strchr(letters, *s)) == NULL)
+      return 0;
+    bits |= 1 << (l - letters);
+    s++;
+    if(*s == ',')
+      s++;
+  }
+  return bits;
+}
+/* Parses "64K" and the like */
+static int parse_amount(const char* s, unsigned long* value)
+{
+  char* end;
+  *value = strtoul(s, &end, 10);
+  if(end == s)
+    return -1;
+  if(*end == 'K' || *end == 'k')
+    *value <<= 10, end++;
+  else if(*end == 'M' || *end == 'm')
+    *value <<= 20, end++;
+  return *end == '\0' ? 0 : -1;
+}
+/* Parses one -D range. Returns the level (0 to 2), -1 if it is bad. */
+static int parse_range(const char* spec)
+{
+  char copy[256];
+  char* fields[8];
+  LevelRange r;
+  int n = 0, level;
+
+  if(strlen(spec) >= sizeof(copy))
+    return -1;
+  strcpy(copy, spec);
+  for(fields[0] = strtok(copy, ":"); fields[n] != NULL && n < 7; fields[++n] = strtok(NULL, ":"))
+    ;
+  if(n != 7 || strtok(NULL, ":") != NULL)
+    return -1;
+  level = atoi(fields[0]) - 1;
+  if(level < 0 || level > 2)
+    return -1;
+  r.num_blocks = parse_values(fields[1], r.blocks);
+  r.num_words = parse_values(fields[2], r.words);
+  r.num_assocs = parse_values(fields[3], r.assocs);
+  r.replacements = parse_letters(fields[4], "LR");
+  r.write_schemes = parse_letters(fields[5], "BT");
+  r.allocate_schemes = parse_letters(fields[6], "AN");
+  if(r.num_blocks == 0 || r.num_words == 0 || r.num_assocs == 0 ||
+    r.replacements == 0 || r.write_schemes == 0 || r.allocate_schemes == 0)
+    return -1;
+  ranges[level] = r;
+  return level;
+}
+
+/* Every geometry and policy a range allows for one level. Returns how many
+  there are; out must have room for all the combinations. */
+static int level_options(const LevelRange* r, CacheInfo* out)
+{
+  int b, w, a, rp, wr, al, n = 0;
+  CacheInfo info;
+
+  memset(&info, 0, sizeof(info));
+  for(b = 0; b < r->num_blocks; b++)
+  for(w = 0; w < r->num_words; w++)
+  for(a = 0; a < r->num_assocs; a++)
+  for(rp = 0; rp < 2; rp++)
+  for(wr = 0; wr < 2; wr++)
+  for(al = 0; al < 2; al++)
+  {
+    if(!(r->replacements & (1 << rp)) || !(r->write_schemes & (1 << wr)) || !(r->allocate_schemes & (1 << al)))
+      continue;
+    info.num_blocks = r->blocks[b];
+    info.words_per_block = r->words[w];
+    info.associativity = r->assocs[a];
+    info.replacement = rp;
+    info.write_scheme = wr;
+    info.allocate_scheme = al;
+    if(info.associativity > info.num_blocks || info.num_blocks % info.associativity != 0 ||
+      power_of_two(info.num_blocks / info.associativity) < 0 || power_of_two(info.words_per_block) < 0)
+      continue;
+    if(wr == Write_WRITE_BACK && al == Allocate_NO_ALLOCATE)
+      continue;
+    /* With one way the replacement policy makes no difference */
+    if(info.associativity == 1 && rp == Replacement_RANDOM && (r->replacements & (1 << Replacement_LRU)))
+      continue;
+    out[n++] = info;
+  }
+  return n;
+}
+
+static int log2_of(int n)
+{
+  int bits = 0;
+  while((1 << bits) < n)
+    bits++;
+  return bits;
+}
+static unsigned long level_bytes(const CacheInfo* c)
+{
+  return (unsigned long)c->num_blocks * c->words_per_block * 4;
+}
+/* Storage bits of a level: data, tag, valid and dirty bits per block and
+  the LRU ranks */
+static unsigned long level_bits(const CacheInfo* c)
+{
+  int sets = c->num_blocks / c->associativity;
+  int tag_bits = 32 - 2 - log2_of(c->words_per_block) - log2_of(sets);
+  unsigned long bits = (unsigned long)c->num_blocks * (32 * c->words_per_block + tag_bits + 2);
+  if(c->replacement == Replacement_LRU)
+    bits += (unsigned long)c->num_blocks * log2_of(c->associativity);
+  return bits;
+}
+
+/* What candidates in one chain share: everything but the last level's
+  associativity, which is stored last */
+static void chain_key(const Candidate* c, int* key)
+{
+  const CacheInfo* last = &c->levels[num_levels - 1];
+  int l, n = 0;
+  for(l = 0; l < num_levels - 1; l++)
+  {
+    key[n++] = c->levels[l].num_blocks;
+    key[n++] = c->levels[l].words_per_block;
+    key[n++] = c->levels[l].associativity;
+    key[n++] = c->levels[l].replacement;
+    key[n++] = c->levels[l].write_scheme;
+    key[n++] = c->levels[l].allocate_scheme;
+  }
+  key[n++] = last->num_blocks / last->associativity;
+  key[n++] = last->words_per_block;
+  key[n++] = last->replacement;
+  key[n++] = last->write_scheme;
+  key[n++] = last->allocate_scheme;
+  key[n++] = last->associativity;
+}
+static int by_chain(const void* a, const void* b)
+{
+  int x[DSE_KEY_ITEMS], y[DSE_KEY_ITEMS], i, n = 6 * num_levels;
+  chain_key(a, x);
+  chain_key(b, y);
+  for(i = 0; i < n; i++)
+  {
+    if(x[i] != y[i])
+      return x[i] < y[i] ? -1 : 1;
+  }
+  return 0;
+}
+static int by_size(const void* a, const void* b)
+{
+  const Candidate* x = a;
+  const Candidate* y = b;
+  if(x->size != y->size)
+    return x->size < y->size ? -1 : 1;
+  if(x->area != y->area)
+    return x->area < y->area ? -1 : 1;
+  return by_chain(a, b);
+}
+static int in_chain(const Candidate* c)
+{
+  const CacheInfo* last = &c->levels[num_levels - 1];
+  return last->replacement == Replacement_LRU && last->allocate_scheme == Allocate_ALLOCATE;
+}
+
+/* Builds the candidate list from the ranges, sorted smallest first with
+  chains numbered. Returns 0 on success. */
+static int make_candidates(unsigned long max_bytes, unsigned long max_bits, int* over_budget)
+{
+  CacheInfo* options[3];
+  int counts[3], pick[3] = { 0, 0, 0 };
+  unsigned long combinations = 1;
+  Candidate c;
+  int l, i, chains, n, capacity = 256;
+
+  for(l = 0; l < num_levels; l++)
+  {
+    options[l] = malloc(sizeof(CacheInfo) * ranges[l].num_blocks * ranges[l].num_words * ranges[l].num_assocs * 8);
+    counts[l] = level_options(&ranges[l], options[l]);
+    if(counts[l] == 0)
+    {
+      fprintf(stderr, "No valid geometry for level %d.\n", l + 1);
+      return -1;
+    }
+    combinations *= counts[l];
+  }
+  if(combinations > DSE_MAX_COMBINATIONS)
+  {
+    fprintf(stderr, "%lu combinations are too many; narrow the ranges.\n", combinations);
+    return -1;
+  }
+
+  candidates = malloc(sizeof(Candidate) * capacity);
+  *over_budget = 0;
+  memset(&c, 0, sizeof(c));
+  while(1)
+  {
+    c.size = c.area = 0;
+    for(l = 0; l < num_levels; l++)
+    {
+      c.levels[l] = options[l][pick[l]];
+      c.size += level_bytes(&c.levels[l]);
+      c.area += level_bits(&c.levels[l]);
+    }
+    for(l = 1; l < num_levels && level_bytes(&c.levels[l]) > level_bytes(&c.levels[l - 1]); l++)
+      ;
+    if(l == num_levels)
+    {
+      if((max_bytes != 0 && c.size > max_bytes) || (max_bits != 0 && c.area > max_bits))
+        (*over_budget)++;
+      else
+      {
+        if(num_candidates == DSE_MAX_CANDIDATES)
+        {
+          fprintf(stderr, "More than %d candidates fit; narrow the ranges or the budget.\n", DSE_MAX_CANDIDATES);
+          return -1;
+        }
+        if(num_candidates == capacity)
+          candidates = realloc(candidates, sizeof(Candidate) * (capacity *= 2));
+        candidates[num_candidates++] = c;
+      }
+    }
+    /* Next combination, level 1 changing fastest */
+    for(l = 0; l < num_levels && ++pick[l] == counts[l]; l++)
+      pick[l] = 0;
+    if(l == num_levels)
+      break;
+  }
+  for(l = 0; l < num_levels; l++)
+    free(options[l]);
+
+  /* Number the chains: sorted by key, a chain is a run that only differs
+    in the last item */
+  qsort(candidates, num_candidates, sizeof(Candidate), by_chain);
+  n = 6 * num_levels - 1;
+  for(i = 0, chains = 0; i < num_candidates; i++)
+  {
+    int x[DSE_KEY_ITEMS], y[DSE_KEY_ITEMS];
+    if(!in_chain(&candidates[i]))
+    {
+      candidates[i].chain = -1;
+      continue;
+    }
+    chain_key(&candidates[i], x);
+    if(i > 0 && candidates[i - 1].chain >= 0)
+    {
+      chain_key(&candidates[i - 1], y);
+      if(memcmp(x, y, sizeof(int) * n) == 0)
+      {
+        candidates[i].chain = candidates[i - 1].chain;
+        continue;
+      }
+    }
+    candidates[i].chain = chains++;
+  }
+  qsort(candidates, num_candidates, sizeof(Candidate), by_size);
+  return chains;
+}
+
+/* Reads the data accesses from a trace file or a workload */
+static int load_accesses(const char* trace_path, const char* workload, unsigned long limit)
+{
+  MemAccess a;
+  int capacity = 1 << 16;
+  TraceReader* trace = NULL;
+  WorkloadInfo info;
+  Workload w;
+
+  if(workload != NULL)
+  {
+    if(parse_workload(workload, &info) != 0)
+    {
+      fprintf(stderr, "Invalid workload %s.\n", workload);
+      return -1;
+    }
+    if(limit != 0)
+      info.count = limit;
+    workload_init(&w, &info);
+  }
+  else if((trace = trace_open(trace_path, Trace_AUTO, 1)) == NULL)
+  {
+    fprintf(stderr, "Could not open trace file.\n");
+    return -1;
+  }
+
+  accesses = malloc(sizeof(MemAccess) * capacity);
+  while(limit == 0 || (unsigned long)num_accesses < limit)
+  {
+    if(workload != NULL ? !workload_next(&w, &a.type, &a.address) : !trace_read(trace, &a))
+      break;
+    if(a.type == Access_I_FETCH)
+      continue;
+    if(num_accesses == capacity)
+    {
+      if(capacity > INT_MAX / 2)
+        break;
+      accesses = realloc(accesses, sizeof(MemAccess) * (capacity *= 2));
+    }
+    a.core = 0;
+    accesses[num_accesses++] = a;
+  }
+  if(workload != NULL)
+    workload_free(&w);
+  else
+    trace_close(trace);
+  if(num_accesses == 0)
+  {
+    fprintf(stderr, "No data accesses to simulate.\n");
+    return -1;
+  }
+  return 0;
+}
+
+/* Simulates one candidate and writes its D-cache statistics to fd. This
+  runs in a child process. */
+static void run_candidate(const Candidate* c, int fd)
+{
+  CacheInfo icache = { 64, 1, 1, Replacement_LRU, Write_WRITE_BACK, Allocate_ALLOCATE, Index_PLAIN };
+  CacheInfo dcache[3];
+  CacheStats istats, dstats[3];
+  int i;
+
+  memcpy(dcache, c->levels, sizeof(dcache));
+  configure_caches(icache, dcache, num_levels);
+  setup_caches();
+  for(i = 0; i < num_accesses; i += DSE_CHUNK)
+    handle_accesses(accesses + i, num_accesses - i < DSE_CHUNK ? num_accesses - i : DSE_CHUNK);
+  get_cache_stats(&istats, dstats);
+  if(write(fd, dstats, sizeof(dstats)) != sizeof(dstats))
+    _exit(1);
+}
+
+/* Works out a candidate's measures from its statistics. Returns whether its
+  last level evicted anything. */
+static int score(Candidate* c, const CacheStats* d)
+{
+  const CacheStats* last = &d[num_levels - 1];
+  double local[3], rest = mem_latency;
+  long long refs, misses;
+  int l;
+
+  c->miss_rate = 1;
+  for(l = 0; l < num_levels; l++)
+  {
+    refs = d[l].num_reads + d[l].num_writes;
+    misses = d[l].compulsory_reads + d[l].conflict_reads + d[l].capacity_reads +
+      d[l].compulsory_writes + d[l].conflict_writes + d[l].capacity_writes;
+    local[l] = refs > 0 ? (double)misses / refs : 0;
+    c->miss_rate *= local[l];
+  }
+  for(l = num_levels - 1; l >= 0; l--)
+    rest = hit_latency[l] + local[l] * rest;
+  c->amat = rest;
+  c->traffic = (double)(last->words_read_mem + last->words_write_mem) / num_accesses;
+  return last->conflict_reads + last->capacity_reads + last->conflict_writes + last->capacity_writes != 0;
+}
+
+/* Whether some other finished candidate is no worse than c on everything
+  and better on something */
+static int dominated(const Candidate* c)
+{
+  const Candidate* d;
+  int i;
+  for(i = 0; i < num_candidates; i++)
+  {
+    d = &candidates[i];
+    if(d == c || d->state != Candidate_DONE)
+      continue;
+    if(d->size <= c->size && d->miss_rate <= c->miss_rate && d->amat <= c->amat && d->traffic <= c->traffic &&
+      (d->size < c->size || d->miss_rate < c->miss_rate || d->amat < c->amat || d->traffic < c->traffic))
+      return 1;
+  }
+  return 0;
+}
+
+static void print_candidate(const Candidate* c)
+{
+  const CacheInfo* info;
+  int l;
+  printf("{\"dse\":%d,\"size_bytes\":%lu,\"area_bits\":%lu,\"miss_rate\":%.6f,\"amat\":%.3f,\"traffic\":%.4f,\"config\":\"",
+    DSE_VERSION, c->size, c->area, c->miss_rate, c->amat, c->traffic);
+  for(l = 0; l < num_levels; l++)
+  {
+    info = &c->levels[l];
+    printf("%s-D %d:%d:%d:%d:%c:%c:%c", l > 0 ? " " : "", l + 1, info->num_blocks, info->words_per_block,
+      info->associativity, "LR"[info->replacement], "BT"[info->write_scheme], "AN"[info->allocate_scheme]);
+  }
+  printf("\"}\n");
+}
+
+int dse_main(int argc, char** argv)
+{
+  const char* trace_path = NULL;
+  const char* workload = NULL;
+  unsigned long limit = 0, max_bytes = 0, max_bits = 0;
+  int max_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  int have_level[3] = { 0, 0, 0 };
+  int* closed_at;
+  Job jobs[DSE_MAX_JOBS];
+  CacheStats dstats[3];
+  Candidate* c;
+  int chains, over_budget, running = 0, next = 0, simulated = 0, pruned = 0, failed = 0, front = 0;
+  int i, j, level, status, fds[2];
+  pid_t pid;
+
+  for(i = 1; i < argc; i++)
+  {
+    if(i == argc - 1)
+    {
+      trace_path = argv[i];
+      break;
+    }
+    if(strcmp(argv[i], "-D") == 0)
+    {
+      if((level = parse_range(argv[++i])) < 0)
+      {
+        fprintf(stderr, "Invalid D-cache range %s.\n", argv[i]);
+        return 1;
+      }
+      have_level[level] = 1;
+    }
+    else if(strcmp(argv[i], "-W") == 0)
+      workload = argv[++i];
+    else if(strcmp(argv[i], "-j") == 0)
+      max_jobs = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-n") == 0)
+      limit = strtoul(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "-c") == 0 && parse_amount(argv[i + 1], &max_bytes) == 0)
+      i++;
+    else if(strcmp(argv[i], "-a") == 0 && parse_amount(argv[i + 1], &max_bits) == 0)
+      i++;
+    else if(strcmp(argv[i], "-h") == 0)
+      sscanf(argv[++i], "%d,%d,%d", &hit_latency[0], &hit_latency[1], &hit_latency[2]);
+    else if(strcmp(argv[i], "-m") == 0)
+      mem_latency = atoi(argv[++i]);
+    else
+    {
+      fprintf(stderr, "Unknown or invalid dse option %s.\n", argv[i]);
+      return 1;
+    }
+  }
+  for(num_levels = 0; num_levels < 3 && have_level[num_levels]; num_levels++)
+    ;
+  if(num_levels == 0 || (num_levels < 3 && have_level[num_levels]) || (num_levels < 2 && have_level[2]))
+  {
+    fprintf(stderr, "Give a -D range for each D-cache level from level 1 down.\n");
+    return 1;
+  }
+  if((workload == NULL) == (trace_path == NULL) || max_jobs < 1)
+  {
+    fprintf(stderr, "Invalid dse parameters; give either a trace or -W.\n");
+    return 1;
+  }
+  if(max_jobs > DSE_MAX_JOBS)
+    max_jobs = DSE_MAX_JOBS;
+
+  if((chains = make_candidates(max_bytes, max_bits, &over_budget)) < 0 ||
+    load_accesses(trace_path, workload, limit) != 0)
+    return 1;
+  if(num_candidates == 0)
+  {
+    fprintf(stderr, "No candidate fits the ranges and the budget.\n");
+    return 1;
+  }
+
+  /* The smallest associativity at which each chain's last level evicted
+    nothing */
+  closed_at = malloc(sizeof(int) * (chains + 1));
+  for(i = 0; i < chains; i++)
+    closed_at[i] = INT_MAX;
+
+  while(next < num_candidates || running > 0)
+  {
+    while(running < max_jobs && next < num_candidates)
+    {
+      c = &candidates[next++];
+      if(c->chain >= 0 && c->levels[num_levels - 1].associativity > closed_at[c->chain])
+      {
+        c->state = Candidate_PRUNED;
+        pruned++;
+        continue;
+      }
+      if(pipe(fds) < 0)
+      {
+        c->state = Candidate_FAILED;
+        failed++;
+        continue;
+      }
+      fflush(stdout);
+      pid = fork();
+      if(pid == 0)
+      {
+        close(fds[0]);
+        run_candidate(c, fds[1]);
+        _exit(0);
+      }
+      close(fds[1]);
+      if(pid < 0)
+      {
+        close(fds[0]);
+        c->state = Candidate_FAILED;
+        failed++;
+        continue;
+      }
+      jobs[running].pid = pid;
+      jobs[running].fd = fds[0];
+      jobs[running].candidate = c;
+      running++;
+    }
+    if(running == 0)
+      break;
+
+    if((pid = waitpid(-1, &status, 0)) < 0)
+      continue;
+    for(j = 0; j < running && jobs[j].pid != pid; j++)
+      ;
+    if(j == running)
+      continue;
+    c = jobs[j].candidate;
+    if(WIFEXITED(status) && WEXITSTATUS(status) == 0 && read(jobs[j].fd, dstats, sizeof(dstats)) == sizeof(dstats))
+    {
+      c->state = Candidate_DONE;
+      simulated++;
+      if(!score(c, dstats) && c->chain >= 0 && c->levels[num_levels - 1].associativity < closed_at[c->chain])
+        closed_at[c->chain] = c->levels[num_levels - 1].associativity;
+    }
+    else
+    {
+      c->state = Candidate_FAILED;
+      failed++;
+    }
+    close(jobs[j].fd);
+    jobs[j] = jobs[--running];
+  }
+
+  for(i = 0; i < num_candidates; i++)
+  {
+    if(candidates[i].state == Candidate_DONE && !dominated(&candidates[i]))
+    {
+      print_candidate(&candidates[i]);
+      front++;
+    }
+  }
+  fprintf(stderr, "%d candidates on %d data accesses: %d simulated, %d pruned, %d failed, %d over budget; %d on the front.\n",
+    num_candidates, num_accesses, simulated, pruned, failed, over_budget, front);
+  free(closed_at);
+  free(candidates);
+  free(accesses);
+  return 0;
+}
@@ -0,0 +1,9 @@
+#ifndef _DSE_H_
+#define _DSE_H_
+
+/* cachesim dse - searches D-cache hierarchies for the Pareto front of miss
+rate, AMAT and memory traffic against size. See dse.c for the options and the
+output format. */
+int dse_main(int argc, char** argv);
+
+#endif
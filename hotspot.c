@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hotspot.h"
+
+/* Parses "20" or "20:region=64K". Returns 0 on success. */
+int parse_hot(const char* spec, int* k, int* region_bits)
+{
+  char* end;
+  unsigned long region = 4096;
+
+  *k = strtol(spec, &end, 10);
+  if(end == spec || *k < 1 || *k > HOT_MAX_K)
+    return -1;
+  if(*end == ':')
+  {
+    if(strncmp(end + 1, "region=", 7) != 0)
+      return -1;
+    region = strtoul(end + 8, &end, 10);
+    if(*end == 'K' || *end == 'k')
+      region <<= 10, end++;
+    else if(*end == 'M' || *end == 'm')
+      region <<= 20, end++;
+  }
+  if(*end != '\0' || region < 4 || (region & (region - 1)) != 0)
+    return -1;
+  for(*region_bits = 0; (1UL << *region_bits) < region; (*region_bits)++)
+    ;
+  return 0;
+}
+
+static unsigned long mix(unsigned long key, int row)
+{
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdUL + 2 * row;
+  key ^= key >> 33;
+  return key;
+}
+
+void hot_init(HotTracker* t, int k)
+{
+  int size = 1;
+  t->capacity = k * HOT_SLOTS_PER_K;
+  while(size < 2 * t->capacity)
+    size *= 2;
+  t->used = 0;
+  t->heap = calloc(t->capacity, sizeof(HotEntry));
+  t->slots = calloc(size, sizeof(int));
+  t->slot_mask = size - 1;
+  t->sketch = calloc(HOT_SKETCH_DEPTH * HOT_SKETCH_WIDTH, sizeof(unsigned long long));
+  t->total = 0;
+}
+
+static int find_slot(HotTracker* t, unsigned long key)
+{
+  int i = mix(key, 0) & t->slot_mask;
+  while(t->slots[i] != 0 && t->heap[t->slots[i] - 1].key != key)
+    i = (i + 1) & t->slot_mask;
+  return i;
+}
+/* Empties a hash slot, shifting later keys of the same run back so the
+  probes never need tombstones */
+static void clear_slot(HotTracker* t, int i)
+{
+  int j = i, home;
+  t->slots[i] = 0;
+  while(1)
+  {
+    j = (j + 1) & t->slot_mask;
+    if(t->slots[j] == 0)
+      return;
+    home = mix(t->heap[t->slots[j] - 1].key, 0) & t->slot_mask;
+    /* The key at j can fill the hole at i unless its home lies in (i, j] */
+    if(((j - home) & t->slot_mask) >= ((j - i) & t->slot_mask))
+    {
+      t->slots[i] = t->slots[j];
+      t->heap[t->slots[i] - 1].slot = i;
+      t->slots[j] = 0;
+      i = j;
+    }
+  }
+}
+static void swap_entries(HotTracker* t, int a, int b)
+{
+  HotEntry e = t->heap[a];
+  t->heap[a] = t->heap[b];
+  t->heap[b] = e;
+  t->slots[t->heap[a].slot] = a + 1;
+  t->slots[t->heap[b].slot] = b + 1;
+}
+static void sift_down(HotTracker* t, int i)
+{
+  int child;
+  while((child = 2 * i + 1) < t->used)
+  {
+    if(child + 1 < t->used && t->heap[child + 1].count < t->heap[child].count)
+      child++;
+    if(t->heap[i].count <= t->heap[child].count)
+      return;
+    swap_entries(t, i, child);
+    i = child;
+  }
+}
+static void sift_up(HotTracker* t, int i)
+{
+  while(i > 0 && t->heap[(i - 1) / 2].count > t->heap[i].count)
+  {
+    swap_entries(t, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+void hot_add(HotTracker* t, unsigned long key)
+{
+  int r, i, slot;
+
+  for(r = 0; r < HOT_SKETCH_DEPTH; r++)
+    t->sketch[r * HOT_SKETCH_WIDTH + (mix(key, r + 1) & (HOT_SKETCH_WIDTH - 1))]++;
+  t->total++;
+
+  slot = find_slot(t, key);
+  if(t->slots[slot] != 0)
+  {
+    i = t->slots[slot] - 1;
+    t->heap[i].count++;
+    sift_down(t, i);
+    return;
+  }
+  if(t->used < t->capacity)
+  {
+    i = t->used++;
+    t->heap[i].key = key;
+    t->heap[i].count = 1;
+    t->heap[i].error = 0;
+    t->heap[i].slot = slot;
+    t->slots[slot] = i + 1;
+    sift_up(t, i);
+    return;
+  }
+  /* Take over the smallest counter */
+  clear_slot(t, t->heap[0].slot);
+  slot = find_slot(t, key);
+  t->heap[0].key = key;
+  t->heap[0].error = t->heap[0].count;
+  t->heap[0].count++;
+  t->heap[0].slot = slot;
+  t->slots[slot] = 1;
+  sift_down(t, 0);
+}
+
+static unsigned long long sketch_estimate(HotTracker* t, unsigned long key)
+{
+  unsigned long long best = ~0ULL, c;
+  int r;
+  for(r = 0; r < HOT_SKETCH_DEPTH; r++)
+  {
+    c = t->sketch[r * HOT_SKETCH_WIDTH + (mix(key, r + 1) & (HOT_SKETCH_WIDTH - 1))];
+    if(c < best)
+      best = c;
+  }
+  return best;
+}
+static unsigned long long estimate(HotTracker* t, const HotEntry* e)
+{
+  unsigned long long sketch = sketch_estimate(t, e->key);
+  return sketch < e->count ? sketch : e->count;
+}
+
+typedef struct
+{
+  HotEntry entry;
+  unsigned long long estimate;
+} Ranked;
+
+static int by_estimate(const void* a, const void* b)
+{
+  const Ranked* x = a;
+  const Ranked* y = b;
+  if(x->estimate != y->estimate)
+    return x->estimate < y->estimate ? 1 : -1;
+  return x->entry.key < y->entry.key ? -1 : x->entry.key > y->entry.key;
+}
+
+/* Prints the k keys with the highest estimates, turning each back into an
+  address with shift */
+void print_hot(const char* what, HotTracker* t, int shift, int k)
+{
+  Ranked* ranked = malloc(sizeof(Ranked) * (t->used ? t->used : 1));
+  int i;
+
+  for(i = 0; i < t->used; i++)
+  {
+    ranked[i].entry = t->heap[i];
+    ranked[i].estimate = estimate(t, &t->heap[i]);
+  }
+  qsort(ranked, t->used, sizeof(Ranked), by_estimate);
+
+  printf("\t%s (%llu in all):\n", what, t->total);
+  if(t->used == 0)
+    printf("\t\tNone\n");
+  for(i = 0; i < t->used && i < k; i++)
+  {
+    printf("\t\t0x%08lx: %llu (at least %llu), %.2f%%\n", ranked[i].entry.key << shift, ranked[i].estimate,
+      ranked[i].entry.count - ranked[i].entry.error, 100.0 * ranked[i].estimate / t->total);
+  }
+  free(ranked);
+}
@@ -0,0 +1,47 @@
+#ifndef _HOTSPOT_H_
+#define _HOTSPOT_H_
+
+/* Heavy-hitter profiling, turned on with
+	--hot <k>[:region=<bytes>]
+
+For every cache level it finds the k blocks, and the k aligned regions of
+<bytes> (a power of two, default 4K), with the most misses and the most
+writebacks, and prints them after the statistics.
+
+Each of those top-k lists is a Space-Saving summary (Metwally et al. 2005) of
+HOT_SLOTS_PER_K * k counters kept in a min-heap, with a hash table to find a
+key's counter. A key that isn't tracked takes over the smallest counter and
+inherits its count as possible error. Next to it a count-min sketch of
+HOT_SKETCH_DEPTH rows of HOT_SKETCH_WIDTH counters gives a second estimate.
+Both only overestimate, so the report shows the smaller of the two, and the
+Space-Saving count less its error as a count the key is sure to have had.
+Memory stays fixed however long the trace is. */
+
+#define HOT_SLOTS_PER_K 4
+#define HOT_MAX_K 1000
+#define HOT_SKETCH_DEPTH 4
+#define HOT_SKETCH_WIDTH 4096
+
+typedef struct
+{
+	unsigned long key;
+	unsigned long long count, error;
+	int slot;                  /* where the key sits in the hash table */
+} HotEntry;
+
+typedef struct
+{
+	int capacity, used;
+	HotEntry* heap;            /* smallest count first */
+	int* slots;                /* heap index + 1 for each key, 0 if empty */
+	int slot_mask;
+	unsigned long long* sketch;
+	unsigned long long total;
+} HotTracker;
+
+int parse_hot(const char* spec, int* k, int* region_bits);
+void hot_init(HotTracker* t, int k);
+void hot_add(HotTracker* t, unsigned long key);
+void print_hot(const char* what, HotTracker* t, int shift, int k);
+
+#endif
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "multicore.h"
+
+/* Each core's trace is parsed by its own thread into one half of a double
+  buffer while the main thread simulates the other half. All threads meet at
+  a barrier once per epoch, and the main thread interleaves the cores' epochs
+  one access at a time in core order, so the global order only depends on the
+  traces. */
+typedef struct
+{
+	TraceReader* trace;
+	int core;
+	MemAccess buffers[2][EPOCH_ACCESSES];
+	int counts[2];
+} CoreReader;
+
+static CoreReader* readers;
+static int num_readers;
+static pthread_barrier_t epoch_barrier;
+
+/* Whether every core ran out of accesses in a buffer half. Only called
+  between the barrier and the next time anyone fills that half. */
+static int all_done(int half)
+{
+  int c;
+  for(c = 0; c < num_readers; c++)
+  {
+    if(readers[c].counts[half] != 0)
+      return 0;
+  }
+  return 1;
+}
+
+static void* reader_main(void* arg)
+{
+  CoreReader* r = arg;
+  int epoch = 0, half, count, i;
+  do
+  {
+    half = epoch & 1;
+    for(count = 0; count < EPOCH_ACCESSES && trace_read(r->trace, &r->buffers[half][count]); count++)
+      ;
+    for(i = 0; i < count; i++)
+      r->buffers[half][i].core = r->core;
+    r->counts[half] = count;
+    pthread_barrier_wait(&epoch_barrier);
+    epoch++;
+  } while(!all_done(half));
+  return NULL;
+}
+
+/* Simulates one trace per core until all of them end, then closes them */
+void run_cores(TraceReader** traces, int cores)
+{
+  pthread_t* threads = malloc(sizeof(pthread_t) * cores);
+  MemAccess* merged = malloc(sizeof(MemAccess) * EPOCH_ACCESSES * cores);
+  int epoch, half, c, i, count;
+
+  readers = calloc(cores, sizeof(CoreReader));
+  num_readers = cores;
+  if(threads == NULL || merged == NULL || readers == NULL)
+  {
+    fprintf(stderr, "Out of memory for the per-core trace buffers.\n");
+    exit(1);
+  }
+  pthread_barrier_init(&epoch_barrier, NULL, cores + 1);
+  for(c = 0; c < cores; c++)
+  {
+    readers[c].trace = traces[c];
+    readers[c].core = c;
+    if(pthread_create(&threads[c], NULL, reader_main, &readers[c]) != 0)
+    {
+      fprintf(stderr, "Could not start a reader thread.\n");
+      exit(1);
+    }
+  }
+
+  for(epoch = 0; ; epoch++)
+  {
+    pthread_barrier_wait(&epoch_barrier);
+    half = epoch & 1;
+    if(all_done(half))
+      break;
+    count = 0;
+    for(i = 0; i < EPOCH_ACCESSES; i++)
+    {
+      for(c = 0; c < cores; c++)
+      {
+        if(i < readers[c].counts[half])
+          merged[count++] = readers[c].buffers[half][i];
+      }
+    }
+    handle_accesses(merged, count);
+  }
+
+  for(c = 0; c < cores; c++)
+  {
+    pthread_join(threads[c], NULL);
+    trace_close(traces[c]);
+  }
+  pthread_barrier_destroy(&epoch_barrier);
+  free(readers);
+  free(merged);
+  free(threads);
+}
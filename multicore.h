@@ -0,0 +1,12 @@
+#ifndef _MULTICORE_H_
+#define _MULTICORE_H_
+
+#include "cachesim.h"
+#include "trace.h"
+
+/* How many accesses each core's reader thread parses per epoch */
+#define EPOCH_ACCESSES 4096
+
+void run_cores(TraceReader** traces, int cores);
+
+#endif
@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "partition.h"
+
+static const char* kind_names[] = { "none", "cat", "ucp" };
+
+/* Parses one class, "core1", "rest" or "10000000-20000000", with an
+  optional "=<mask>" */
+static int parse_class(char* item, PartitionClass* c, int with_mask)
+{
+  char* mask = strchr(item, '=');
+  char* end;
+
+  if((mask != NULL) != with_mask)
+    return -1;
+  if(mask != NULL)
+  {
+    *mask++ = '\0';
+    c->mask = strtoul(mask, &end, 16);
+    if(*end != '\0' || c->mask == 0)
+      return -1;
+  }
+  if(strlen(item) >= sizeof(c->name))
+    return -1;
+  strcpy(c->name, item);
+  c->core = -1;
+  c->rest = 0;
+  if(strcmp(item, "rest") == 0)
+    c->rest = 1;
+  else if(strncmp(item, "core", 4) == 0)
+  {
+    c->core = strtol(item + 4, &end, 10);
+    if(end == item + 4 || *end != '\0' || c->core < 0)
+      return -1;
+  }
+  else if(sscanf(item, "%lx-%lx", &c->start, &c->end) != 2 || c->start >= c->end)
+    return -1;
+  return 0;
+}
+
+/* Parses "2:cat:core0=0f,core1=f0" or "2:ucp:0-80000000,rest:interval=50000"
+  into level (0-based) and p. Returns 0 on success. */
+int parse_partition(const char* spec, int* level, Partition* p)
+{
+  char buf[512];
+  char* kind;
+  char* list;
+  char* option;
+  char* item;
+  int i;
+
+  if(strlen(spec) >= sizeof(buf))
+    return -1;
+  strcpy(buf, spec);
+  memset(p, 0, sizeof(*p));
+  p->interval = 100000;
+
+  kind = strchr(buf, ':');
+  if(kind == NULL)
+    return -1;
+  *kind++ = '\0';
+  *level = atoi(buf);
+  if(*level < 1 || *level > 3)
+    return -1;
+  (*level)--;
+  list = strchr(kind, ':');
+  if(list == NULL)
+    return -1;
+  *list++ = '\0';
+  if(strcmp(kind, "cat") == 0)
+    p->kind = Partition_CAT;
+  else if(strcmp(kind, "ucp") == 0)
+    p->kind = Partition_UCP;
+  else
+    return -1;
+  option = strchr(list, ':');
+  if(option != NULL)
+  {
+    *option++ = '\0';
+    if(strncmp(option, "interval=", 9) != 0 || (p->interval = atoi(option + 9)) < 1)
+      return -1;
+  }
+
+  for(item = strtok(list, ","); item != NULL; item = strtok(NULL, ","))
+  {
+    if(p->classes == PARTITION_MAX_CLASSES)
+      return -1;
+    if(parse_class(item, &p->cls[p->classes], p->kind == Partition_CAT) != 0)
+      return -1;
+    p->classes++;
+  }
+  for(i = 0; i < p->classes && !p->cls[i].rest; i++)
+    ;
+  if(i == p->classes && p->kind == Partition_CAT)
+  {
+    if(p->classes == PARTITION_MAX_CLASSES)
+      return -1;
+    strcpy(p->cls[i].name, "rest");
+    p->cls[i].core = -1;
+    p->cls[i].rest = 1;
+    p->cls[i].mask = ~0UL;
+    p->classes++;
+  }
+  return 0;
+}
+
+void partition_init(Partition* p, int rows, int ways)
+{
+  int c, sampled = (rows + UCP_SAMPLE - 1) / UCP_SAMPLE;
+  p->rows = rows;
+  p->ways = ways;
+  p->owners = calloc((size_t)rows * ways, 1);
+  for(c = 0; c < p->classes; c++)
+  {
+    p->cls[c].mask &= ways >= 64 ? ~0UL : (1UL << ways) - 1;
+    p->quota[c] = ways / p->classes + (c < ways % p->classes);
+  }
+  if(p->kind == Partition_UCP)
+  {
+    p->shadow = calloc((size_t)p->classes * sampled * ways, sizeof(unsigned long));
+    p->utility = calloc((size_t)p->classes * ways, sizeof(unsigned long long));
+    p->countdown = p->interval;
+  }
+}
+
+int partition_class(const Partition* p, addr_t address, int core)
+{
+  int c;
+  for(c = 0; c < p->classes; c++)
+  {
+    const PartitionClass* k = &p->cls[c];
+    if(k->rest || (k->core >= 0 ? k->core == core : address >= k->start && address < k->end))
+      return c;
+  }
+  return p->classes - 1;
+}
+
+/* Hands out the ways by marginal utility: each round, the class whose best
+  run of extra ways buys the most shadow hits per way gets that run */
+static void repartition(Partition* p)
+{
+  int alloc[PARTITION_MAX_CLASSES];
+  int balance = p->ways - p->classes;
+  int c, k, best_c, best_k, d;
+  double mu, best_mu;
+  unsigned long long hits;
+
+  for(c = 0; c < p->classes; c++)
+    alloc[c] = 1;
+  while(balance > 0)
+  {
+    best_c = 0;
+    best_k = 1;
+    best_mu = -1;
+    for(c = 0; c < p->classes; c++)
+    {
+      hits = 0;
+      for(k = 1; k <= balance && alloc[c] + k <= p->ways; k++)
+      {
+        hits += p->utility[c * p->ways + alloc[c] + k - 1];
+        mu = (double)hits / k;
+        if(mu > best_mu)
+        {
+          best_mu = mu;
+          best_c = c;
+          best_k = k;
+        }
+      }
+    }
+    alloc[best_c] += best_k;
+    balance -= best_k;
+  }
+  for(c = 0; c < p->classes; c++)
+  {
+    p->quota[c] = alloc[c];
+    for(d = 0; d < p->ways; d++)
+      p->utility[c * p->ways + d] /= 2;
+  }
+  p->repartitions++;
+}
+
+/* Counts an access by class cls for UCP: updates its shadow tags if row is
+  sampled and repartitions at the end of an interval */
+void partition_access(Partition* p, int cls, int row, unsigned long block)
+{
+  unsigned long* set;
+  int d;
+
+  if(p->kind != Partition_UCP)
+    return;
+  if(row % UCP_SAMPLE == 0)
+  {
+    set = &p->shadow[((size_t)cls * ((p->rows + UCP_SAMPLE - 1) / UCP_SAMPLE) + row / UCP_SAMPLE) * p->ways];
+    for(d = 0; d < p->ways - 1 && set[d] != block + 1; d++)
+      ;
+    if(set[d] == block + 1)
+      p->utility[cls * p->ways + d]++;
+    memmove(&set[1], &set[0], sizeof(unsigned long) * d);
+    set[0] = block + 1;
+  }
+  if(--p->countdown == 0)
+  {
+    repartition(p);
+    p->countdown = p->interval;
+  }
+}
+
+/* Picks the way a miss by class cls replaces in a full set: the LRU one, or
+  a random one if lru isn't set, of the ways the partitioning allows */
+int partition_victim(Partition* p, CacheArray* cache, int row, int cls, int lru)
+{
+  unsigned char* owners = &p->owners[(size_t)row * p->ways];
+  int held[PARTITION_MAX_CLASSES] = { 0 };
+  int allowed[64] = { 0 };
+  int w, n = 0, best = 0;
+
+  if(p->kind == Partition_CAT)
+  {
+    for(w = 0; w < p->ways && w < 64; w++)
+    {
+      if(p->cls[cls].mask >> w & 1)
+        allowed[n++] = w;
+    }
+  }
+  else
+  {
+    for(w = 0; w < p->ways; w++)
+      held[owners[w]]++;
+    for(w = 0; w < p->ways && w < 64; w++)
+    {
+      if(held[cls] < p->quota[cls] ? owners[w] != cls && held[owners[w]] > p->quota[owners[w]] : owners[w] == cls)
+        allowed[n++] = w;
+    }
+    if(n == 0 && held[cls] < p->quota[cls])
+    {
+      for(w = 0; w < p->ways && w < 64; w++)
+      {
+        if(owners[w] != cls)
+          allowed[n++] = w;
+      }
+    }
+  }
+  if(n == 0)
+  {
+    for(w = 0; w < p->ways && w < 64; w++)
+      allowed[n++] = w;
+  }
+  if(!lru)
+    return allowed[rand() % n];
+  for(w = 1; w < n; w++)
+  {
+    if(lru_rank(cache, row, allowed[w]) > lru_rank(cache, row, allowed[best]))
+      best = w;
+  }
+  return allowed[best];
+}
+
+void print_partition(Partition* p, CacheArray* cache)
+{
+  int blocks[PARTITION_MAX_CLASSES] = { 0 };
+  unsigned long i;
+  int c;
+
+  for(i = 0; i < (unsigned long)p->rows * p->ways; i++)
+  {
+    if(cache->blocks[i] & BLOCK_VALID)
+      blocks[p->owners[i]]++;
+  }
+  printf("\tWay partitioning (%s", kind_names[p->kind]);
+  if(p->kind == Partition_UCP)
+    printf(", %d repartitions", p->repartitions);
+  printf("):\n");
+  for(c = 0; c < p->classes; c++)
+  {
+    PartitionStats* s = &p->stats[c];
+    printf("\t\t%s: %llu accesses, %llu misses (%.2f%%), ", p->cls[c].name, s->accesses, s->misses,
+      s->accesses ? 100.0 * s->misses / s->accesses : 0.0);
+    if(p->kind == Partition_CAT)
+      printf("mask 0x%lx, ", p->cls[c].mask);
+    else
+      printf("%d ways, ", p->quota[c]);
+    printf("%d blocks held\n", blocks[c]);
+  }
+}
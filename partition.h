@@ -0,0 +1,78 @@
+#ifndef _PARTITION_H_
+#define _PARTITION_H_
+
+#include "cachesim.h"
+
+/* Splits the ways of a D-cache level between classes of accesses, with
+	-C <level>:<kind>:<class>[=<mask>][,<class>[=<mask>]...][:interval=<n>]
+
+A class is one of
+	core<n>        accesses by core n (see --cores)
+	<start>-<end>  accesses to a hex address range, end exclusive
+	rest           everything no other class takes
+The first class that matches an access takes it. Without a rest class, cat
+adds one with every way and ucp gives the leftovers to the last class.
+
+The kind can be:
+	cat  way masks like Intel CAT: <mask> is a hex bitmask of the ways the
+	     class may replace. Lookups still hit in any way.
+	ucp  utility-based partitioning (Qureshi and Patt 2006). Each class has
+	     LRU shadow tags for one set in UCP_SAMPLE, which count the hits it
+	     would get at every recency depth if it had whole sets to itself.
+	     Every interval accesses to the level (default 100000) the ways are
+	     handed out again with the lookahead algorithm, at least one per
+	     class. A miss replaces another class's block while its own class
+	     holds fewer than its share of the set, and its own LRU one after.
+
+Lookups stop at the first empty way, so empty ways are filled in order by
+whoever misses first and the partitions only hold once a set is full. A block
+belongs to the class that last touched it. */
+
+#define PARTITION_MAX_CLASSES 8
+#define UCP_SAMPLE 32
+
+typedef enum
+{
+	Partition_NONE,
+	Partition_CAT,
+	Partition_UCP,
+} PartitionKind;
+
+typedef struct
+{
+	char name[32];
+	int core;            /* -1 unless it is a core<n> class */
+	int rest;
+	addr_t start, end;   /* for an address range */
+	unsigned long mask;  /* cat: ways the class may replace */
+} PartitionClass;
+
+typedef struct
+{
+	unsigned long long accesses, misses;
+} PartitionStats;
+
+typedef struct
+{
+	PartitionKind kind;
+	int classes;
+	PartitionClass cls[PARTITION_MAX_CLASSES];
+	int interval;
+	/* Filled in by partition_init() */
+	int rows, ways;
+	unsigned char* owners;            /* class of each block */
+	int quota[PARTITION_MAX_CLASSES]; /* ucp: ways per class */
+	unsigned long* shadow;            /* ucp: [class][sampled set][way], block + 1, MRU first */
+	unsigned long long* utility;      /* ucp: [class][depth] shadow hits */
+	int countdown, repartitions;
+	PartitionStats stats[PARTITION_MAX_CLASSES];
+} Partition;
+
+int parse_partition(const char* spec, int* level, Partition* p);
+void partition_init(Partition* p, int rows, int ways);
+int partition_class(const Partition* p, addr_t address, int core);
+void partition_access(Partition* p, int cls, int row, unsigned long block);
+int partition_victim(Partition* p, CacheArray* cache, int row, int cls, int lru);
+void print_partition(Partition* p, CacheArray* cache);
+
+#endif
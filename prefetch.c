@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "prefetch.h"
+
+#define STREAM_REGION_SHIFT 6
+#define STREAM_CONFIDENT 2
+#define BO_SCORE_MAX 31
+#define BO_ROUND_MAX 100
+#define BO_BAD_SCORE 1
+
+static const char* prefetcher_names[] =
+{
+	"none", "next", "stride", "bo",
+};
+
+/* Best-Offset candidates: offsets up to 64 with no prime factor above 5 */
+static const int bo_offsets[BO_NUM_OFFSETS] =
+{
+	1, 2, 3, 4, 5, 6, 8, 9, 10, 12, 15, 16, 18, 20, 24, 25, 27, 30, 32, 36,
+	40, 45, 48, 50, 54, 60, 64,
+};
+
+const char* prefetcher_name(PrefetchKind kind)
+{
+  return prefetcher_names[kind];
+}
+
+/* Parses "2:stride:degree=4" into level (0-based) and info. Returns 0 on
+  success and -1 if the spec is malformed. */
+int parse_prefetcher(const char* spec, int* level, PrefetchInfo* info)
+{
+  char buf[128];
+  char* item;
+  char* value;
+  int k;
+
+  if(strlen(spec) >= sizeof(buf))
+    return -1;
+  strcpy(buf, spec);
+
+  item = strtok(buf, ":");
+  if(item == NULL || sscanf(item, "%d", level) != 1 || *level < 1 || *level > 3)
+    return -1;
+  (*level)--;
+
+  item = strtok(NULL, ":");
+  if(item == NULL)
+    return -1;
+  for(k = Prefetch_NEXT_LINE; k <= Prefetch_BEST_OFFSET; k++)
+  {
+    if(strcmp(item, prefetcher_names[k]) == 0)
+      break;
+  }
+  if(k > Prefetch_BEST_OFFSET)
+    return -1;
+
+  info->kind = k;
+  info->degree = (k == Prefetch_STRIDE) ? 2 : 1;
+  info->entries = 16;
+  info->delay = 4;
+
+  while((item = strtok(NULL, ":")) != NULL)
+  {
+    value = strchr(item, '=');
+    if(value == NULL)
+      return -1;
+    *value++ = '\0';
+    if(strcmp(item, "degree") == 0)
+      info->degree = atoi(value);
+    else if(strcmp(item, "entries") == 0)
+      info->entries = atoi(value);
+    else if(strcmp(item, "delay") == 0)
+      info->delay = atoi(value);
+    else
+      return -1;
+  }
+
+  if(info->degree < 1 || info->degree > PREFETCH_MAX_DEGREE || info->entries < 1 || info->delay < 0)
+    return -1;
+  return 0;
+}
+
+void prefetcher_init(Prefetcher* p, const PrefetchInfo* info)
+{
+  memset(p, 0, sizeof(*p));
+  p->info = *info;
+  if(info->kind == Prefetch_STRIDE)
+    p->streams = calloc(info->entries, sizeof(StreamEntry));
+  p->best_offset = 1;
+}
+
+/* Stream table lookup: trains the entry for block's region and returns how
+  many blocks to prefetch */
+static int train_stride(Prefetcher* p, unsigned long block, unsigned long* candidates)
+{
+  unsigned long region = block >> STREAM_REGION_SHIFT;
+  StreamEntry* e = NULL;
+  StreamEntry* oldest = &p->streams[0];
+  long stride;
+  int i;
+
+  for(i = 0; i < p->info.entries; i++)
+  {
+    if(p->streams[i].last_used != 0 && p->streams[i].region == region)
+    {
+      e = &p->streams[i];
+      break;
+    }
+    if(p->streams[i].last_used < oldest->last_used)
+      oldest = &p->streams[i];
+  }
+
+  if(e == NULL)
+  {
+    /* New stream, replacing the least recently used one */
+    e = oldest;
+    e->region = region;
+    e->last_block = block;
+    e->stride = 0;
+    e->confidence = 0;
+    e->last_used = p->now;
+    return 0;
+  }
+
+  e->last_used = p->now;
+  stride = (long)(block - e->last_block);
+  if(stride == 0)
+    return 0;
+  if(stride == e->stride)
+  {
+    if(e->confidence < STREAM_CONFIDENT + 1)
+      e->confidence++;
+  }
+  else
+  {
+    e->stride = stride;
+    e->confidence = 0;
+  }
+  e->last_block = block;
+
+  if(e->confidence < STREAM_CONFIDENT)
+    return 0;
+  for(i = 0; i < p->info.degree; i++)
+    candidates[i] = block + e->stride * (i + 1);
+  return p->info.degree;
+}
+
+static int rr_index(unsigned long block)
+{
+  return (block ^ (block >> 8)) & (BO_RR_SIZE - 1);
+}
+/* One Best-Offset learning step: scores the next offset in turn by whether
+  block - offset was recently filled, and picks a new best offset at the end
+  of each learning phase */
+static void learn_best_offset(Prefetcher* p, unsigned long block)
+{
+  unsigned long base = block - bo_offsets[p->test_index];
+  int i, best;
+
+  if(p->rr[rr_index(base)] == base + 1)
+    p->scores[p->test_index]++;
+
+  best = p->test_index;
+  if(++p->test_index == BO_NUM_OFFSETS)
+  {
+    p->test_index = 0;
+    p->round++;
+  }
+  if(p->scores[best] < BO_SCORE_MAX && p->round < BO_ROUND_MAX)
+    return;
+
+  for(i = 0; i < BO_NUM_OFFSETS; i++)
+  {
+    if(p->scores[i] > p->scores[best])
+      best = i;
+  }
+  p->best_offset = (p->scores[best] > BO_BAD_SCORE) ? bo_offsets[best] : 0;
+  memset(p->scores, 0, sizeof(p->scores));
+  p->test_index = 0;
+  p->round = 0;
+}
+
+/* Tells the prefetcher about a demand access to block. miss is set if it
+  missed this level, prefetch_hit if it hit a block a prefetch brought in.
+  Fills candidates with the blocks to prefetch and returns how many. */
+int prefetcher_train(Prefetcher* p, unsigned long block, int miss, int prefetch_hit, unsigned long* candidates)
+{
+  int i;
+
+  p->now++;
+  switch(p->info.kind)
+  {
+    case Prefetch_NONE:
+      return 0;
+    case Prefetch_NEXT_LINE:
+      if(!miss && !prefetch_hit)
+        return 0;
+      for(i = 0; i < p->info.degree; i++)
+        candidates[i] = block + i + 1;
+      return p->info.degree;
+    case Prefetch_STRIDE:
+      return train_stride(p, block, candidates);
+    case Prefetch_BEST_OFFSET:
+      if(!miss && !prefetch_hit)
+        return 0;
+      learn_best_offset(p, block);
+      if(p->best_offset == 0)
+      {
+        /* Prefetching is off; keep learning from demand fills */
+        if(miss)
+          p->rr[rr_index(block)] = block + 1;
+        return 0;
+      }
+      for(i = 0; i < p->info.degree; i++)
+        candidates[i] = block + (unsigned long)p->best_offset * (i + 1);
+      return p->info.degree;
+  }
+  return 0;
+}
+
+/* Tells the prefetcher a prefetch of block has been filled */
+void prefetcher_filled(Prefetcher* p, unsigned long block)
+{
+  unsigned long base;
+  if(p->info.kind == Prefetch_BEST_OFFSET)
+  {
+    base = block - p->best_offset;
+    p->rr[rr_index(base)] = base + 1;
+  }
+}
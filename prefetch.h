@@ -0,0 +1,73 @@
+#ifndef _PREFETCH_H_
+#define _PREFETCH_H_
+
+/* Hardware prefetcher models that can be attached to any D-cache level with
+	-P <level>:<kind>[:<setting>=<value>...]
+
+The kind can be:
+	next    next-N-line: on a miss (or a hit on a prefetched block), prefetch
+	        the next degree blocks
+	stride  stream table: tracks the block stride in up to entries regions
+	        of 64 blocks and prefetches degree strides ahead once it repeats
+	bo      Best-Offset: learns the single block offset that would have
+	        made recent accesses timely and prefetches with it
+
+Settings shared by all of them:
+	degree   how many blocks to prefetch per trigger (default 1; 2 for stride)
+	entries  stream table size for stride (default 16)
+	delay    how many accesses to this level a prefetch takes to arrive
+	         (default 4). A demand miss on a block still in flight is late.
+
+The prefetcher only decides which blocks to fetch. Queueing, filling through
+the normal read path and the statistics live with the caches in cachesim.c. */
+
+typedef enum
+{
+	Prefetch_NONE,
+	Prefetch_NEXT_LINE,
+	Prefetch_STRIDE,
+	Prefetch_BEST_OFFSET,
+} PrefetchKind;
+
+typedef struct
+{
+	PrefetchKind kind;
+	int degree;
+	int entries;
+	int delay;
+} PrefetchInfo;
+
+/* One stream table entry for the stride prefetcher */
+typedef struct
+{
+	unsigned long region;
+	unsigned long last_block;
+	long stride;
+	int confidence;
+	unsigned long last_used;
+} StreamEntry;
+
+#define BO_NUM_OFFSETS 27
+#define BO_RR_SIZE 256
+
+typedef struct
+{
+	PrefetchInfo info;
+	unsigned long now;
+	/* stride */
+	StreamEntry* streams;
+	/* best-offset */
+	unsigned long rr[BO_RR_SIZE];
+	int scores[BO_NUM_OFFSETS];
+	int test_index, round, best_offset;
+} Prefetcher;
+
+#define PREFETCH_MAX_DEGREE 16
+
+int parse_prefetcher(const char* spec, int* level, PrefetchInfo* info);
+const char* prefetcher_name(PrefetchKind kind);
+void prefetcher_init(Prefetcher* p, const PrefetchInfo* info);
+int prefetcher_train(Prefetcher* p, unsigned long block, int miss, int prefetch_hit, unsigned long* candidates);
+void prefetcher_filled(Prefetcher* p, unsigned long block);
+
+#endif
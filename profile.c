@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include "profile.h"
+
+#ifdef CACHESIM_PROFILE
+
+int prof_enabled;
+int prof_current;
+unsigned long long prof_last;
+unsigned long long prof_cycles[PROF_NUM_UNITS][Prof_NUM_PHASES];
+unsigned long long prof_hits[PROF_NUM_UNITS], prof_misses[PROF_NUM_UNITS];
+
+static const char* phase_names[Prof_NUM_PHASES] =
+{
+	"parse", "dispatch", "lookup", "replace", "fill", "writeback",
+};
+static const char* unit_names[PROF_NUM_UNITS] =
+{
+	"trace", "I", "L1 D", "L2 D", "L3 D",
+};
+
+void profile_start()
+{
+  prof_enabled = 1;
+  prof_current = PROF_TRACE * Prof_NUM_PHASES + Prof_PARSE;
+  prof_last = prof_now();
+}
+/* Prints the cycles spent in each phase of each unit, as a share of the
+  whole run, along with how many accesses took the hit and miss paths */
+void print_profile()
+{
+  unsigned long long total = 0, unit_total;
+  int u, p;
+
+  if(!prof_enabled)
+    return;
+  prof_enter(Prof_PARSE, PROF_TRACE);
+  for(u = 0; u < PROF_NUM_UNITS; u++)
+    for(p = 0; p < Prof_NUM_PHASES; p++)
+      total += prof_cycles[u][p];
+  if(total == 0)
+    total = 1;
+
+  printf("\n\nSimulator profile (%llu ticks):\n", total);
+  printf("\t%-6s", "");
+  for(p = 0; p < Prof_NUM_PHASES; p++)
+    printf("%11s", phase_names[p]);
+  printf("%11s%12s%12s\n", "total", "hits", "misses");
+  for(u = 0; u < PROF_NUM_UNITS; u++)
+  {
+    unit_total = 0;
+    for(p = 0; p < Prof_NUM_PHASES; p++)
+      unit_total += prof_cycles[u][p];
+    if(unit_total == 0)
+      continue;
+    printf("\t%-6s", unit_names[u]);
+    for(p = 0; p < Prof_NUM_PHASES; p++)
+      printf("%10.2f%%", prof_cycles[u][p] * 100.0 / total);
+    printf("%10.2f%%", unit_total * 100.0 / total);
+    if(u == PROF_TRACE)
+      printf("\n");
+    else
+      printf("%12llu%12llu\n", prof_hits[u], prof_misses[u]);
+  }
+}
+
+#else
+
+void profile_start()
+{
+}
+void print_profile()
+{
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+/* Hot-path profiling of the simulator itself. Build with
+	make PROFILE=1
+and run with --profile to get a breakdown of where the host time goes, per
+phase and per cache level, printed after the statistics.
+
+Time is accumulated as a state machine: PROF_ENTER charges the cycles since
+the last call to whatever phase was current, then switches to the new one.
+That makes every cycle land in exactly one bucket, and recursion into the
+next level is excluded from the caller's numbers by PROF_SAVE/PROF_RESTORE
+around the call.
+
+Without CACHESIM_PROFILE defined every macro here expands to nothing, so the
+normal build pays nothing for it. */
+
+typedef enum
+{
+	Prof_PARSE,       /* reading and decoding the trace */
+	Prof_DISPATCH,    /* handle_access picking a cache */
+	Prof_LOOKUP,      /* tag search in the set */
+	Prof_REPLACEMENT, /* victim choice and LRU update */
+	Prof_FILL,        /* bringing the new block in */
+	Prof_WRITEBACK,   /* writing a dirty or written-through block out */
+	Prof_NUM_PHASES,
+} ProfPhase;
+
+/* Unit 0 is the trace reader, 1 the I-cache, 2..4 the D-cache levels */
+#define PROF_TRACE 0
+#define PROF_ICACHE 1
+#define PROF_DCACHE(level) (2 + (level))
+#define PROF_NUM_UNITS 5
+
+#ifdef CACHESIM_PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline unsigned long long prof_now() { return __rdtsc(); }
+#else
+#include <time.h>
+static inline unsigned long long prof_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+extern int prof_enabled;
+extern int prof_current;
+extern unsigned long long prof_last;
+extern unsigned long long prof_cycles[PROF_NUM_UNITS][Prof_NUM_PHASES];
+extern unsigned long long prof_hits[PROF_NUM_UNITS], prof_misses[PROF_NUM_UNITS];
+
+static inline void prof_enter(int phase, int unit)
+{
+  unsigned long long t = prof_now();
+  prof_cycles[prof_current / Prof_NUM_PHASES][prof_current % Prof_NUM_PHASES] += t - prof_last;
+  prof_last = t;
+  prof_current = unit * Prof_NUM_PHASES + phase;
+}
+
+#define PROF_ENTER(phase, unit) do { if(prof_enabled) prof_enter((phase), (unit)); } while(0)
+#define PROF_SAVE() int prof_saved = prof_current
+#define PROF_RESTORE() do { if(prof_enabled) prof_enter(prof_saved % Prof_NUM_PHASES, prof_saved / Prof_NUM_PHASES); } while(0)
+#define PROF_HIT(unit) do { prof_hits[unit]++; } while(0)
+#define PROF_HITS(unit, n) do { prof_hits[unit] += (n); } while(0)
+#define PROF_MISS(unit) do { prof_misses[unit]++; } while(0)
+
+#else
+
+#define PROF_ENTER(phase, unit) do { } while(0)
+#define PROF_SAVE() do { } while(0)
+#define PROF_RESTORE() do { } while(0)
+#define PROF_HIT(unit) do { } while(0)
+#define PROF_HITS(unit, n) do { } while(0)
+#define PROF_MISS(unit) do { } while(0)
+
+#endif
+
+void profile_start();
+void print_profile();
+
+#endif
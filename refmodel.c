@@ -0,0 +1,300 @@
+#include <stdlib.h>
+#include <string.h>
+#include "refmodel.h"
+
+static int log2_of(int n)
+{
+  int bits = 0;
+  while((1 << bits) < n)
+    bits++;
+  return bits;
+}
+static int is_prime(int n)
+{
+  int d;
+  for(d = 2; d * d <= n; d++)
+  {
+    if(n % d == 0)
+      return 0;
+  }
+  return n > 1;
+}
+
+void ref_init(RefModel* m, const CacheInfo* icache, const CacheInfo* dcaches, int levels)
+{
+  RefCache* c;
+  int x;
+
+  memset(m, 0, sizeof(RefModel));
+  m->levels = levels;
+  for(x = 0; x <= levels; x++)
+  {
+    c = &m->caches[x];
+    c->info = x == 0 ? *icache : dcaches[x - 1];
+    c->sets = c->info.num_blocks / c->info.associativity;
+    if(c->info.index == Index_PRIME)
+    {
+      while(c->sets > 2 && !is_prime(c->sets))
+        c->sets--;
+    }
+    c->ways = calloc((size_t)c->sets * c->info.associativity, sizeof(RefWay));
+  }
+}
+/* Hands the model a rand() result the simulator drew for random replacement */
+void ref_draw(RefModel* m, int draw)
+{
+  if(m->num_draws == REF_MAX_DRAWS)
+  {
+    m->error = "too many random draws in one access";
+    return;
+  }
+  m->draws[m->num_draws++] = draw;
+}
+
+unsigned long ref_block(const RefCache* c, addr_t address)
+{
+  return address >> (2 + log2_of(c->info.words_per_block));
+}
+int ref_set(const RefCache* c, unsigned long block)
+{
+  int bits = log2_of(c->sets), set = 0;
+  if(c->info.index != Index_XOR)
+    return block % c->sets;
+  for(; block != 0 && bits != 0; block >>= bits)
+    set ^= block & (c->sets - 1);
+  return set;
+}
+static RefWay* way_at(const RefCache* c, int set, int way)
+{
+  return &c->ways[set * c->info.associativity + way];
+}
+/* How many valid ways of the set were used after this one */
+int ref_rank(const RefCache* c, int set, int way)
+{
+  int rank = 0, j;
+  for(j = 0; j < c->info.associativity; j++)
+  {
+    if(way_at(c, set, j)->valid && way_at(c, set, j)->used > way_at(c, set, way)->used)
+      rank++;
+  }
+  return rank;
+}
+
+static void touch(RefModel* m, int x, int set)
+{
+  int i;
+  for(i = 0; i < m->num_touched; i++)
+  {
+    if(m->touched_cache[i] == x && m->touched_set[i] == set)
+      return;
+  }
+  if(m->num_touched < REF_MAX_TOUCHED)
+  {
+    m->touched_cache[m->num_touched] = x;
+    m->touched_set[m->num_touched++] = set;
+  }
+}
+/* Returns the way holding block, or -1 if it isn't there, with the first
+  empty way in *empty (-1 if the set is full) */
+static int lookup(const RefCache* c, int set, unsigned long block, int* empty)
+{
+  RefWay* w;
+  int j;
+  *empty = -1;
+  for(j = 0; j < c->info.associativity; j++)
+  {
+    w = way_at(c, set, j);
+    if(w->valid && w->block == block)
+      return j;
+    if(!w->valid && *empty < 0)
+      *empty = j;
+  }
+  return -1;
+}
+static void count_miss(RefCache* c, int empty, int is_write)
+{
+  CacheStats* s = &c->stats;
+  if(empty >= 0)
+  {
+    if(is_write)
+      s->compulsory_writes++;
+    else
+      s->compulsory_reads++;
+  }
+  else if(c->info.associativity == 1)
+  {
+    if(is_write)
+      s->conflict_writes++;
+    else
+      s->conflict_reads++;
+  }
+  else if(is_write)
+    s->capacity_writes++;
+  else
+    s->capacity_reads++;
+}
+/* The way a missing block goes in: the first empty one, or else the one
+  the replacement policy gives up */
+static int choose_way(RefModel* m, const RefCache* c, int set, int empty)
+{
+  int j, oldest = 0;
+  if(empty >= 0)
+    return empty;
+  if(c->info.replacement == Replacement_RANDOM)
+  {
+    if(m->next_draw == m->num_draws)
+    {
+      m->error = "the reference needed a random draw the simulator didn't make";
+      return 0;
+    }
+    return m->draws[m->next_draw++] % c->info.associativity;
+  }
+  for(j = 1; j < c->info.associativity; j++)
+  {
+    if(way_at(c, set, j)->used < way_at(c, set, oldest)->used)
+      oldest = j;
+  }
+  return oldest;
+}
+static void use(RefModel* m, RefWay* w)
+{
+  w->used = ++m->clock;
+}
+
+static void access_level(RefModel* m, int level, AccessType type, addr_t address);
+
+/* Sends a read or write of address to the level below, if there is one */
+static void below(RefModel* m, int level, AccessType type, addr_t address)
+{
+  if(level + 1 < m->levels)
+    access_level(m, level + 1, type, address);
+}
+/* Empties a way for a new block, writing the old one back if it is dirty */
+static void evict(RefModel* m, int level, RefCache* c, RefWay* w)
+{
+  if(w->valid && w->dirty)
+  {
+    c->stats.words_write_mem += c->info.words_per_block;
+    below(m, level, Access_D_WRITE, (addr_t)(w->block << (2 + log2_of(c->info.words_per_block))));
+  }
+  w->valid = 0;
+}
+static void fetch(RefModel* m, int level, RefCache* c, addr_t address)
+{
+  c->stats.words_read_mem += c->info.words_per_block;
+  below(m, level, Access_D_READ, address);
+}
+static void write_through(RefModel* m, int level, RefCache* c, addr_t address)
+{
+  c->stats.words_write_mem++;
+  below(m, level, Access_D_WRITE, address);
+}
+
+/* One access to D-cache level (0 to 2) */
+static void access_level(RefModel* m, int level, AccessType type, addr_t address)
+{
+  RefCache* c = &m->caches[level + 1];
+  unsigned long block = ref_block(c, address);
+  int set = ref_set(c, block), hit, empty, way;
+  int through = c->info.write_scheme == Write_WRITE_THROUGH;
+  int allocate = c->info.allocate_scheme == Allocate_ALLOCATE;
+  RefWay* w;
+
+  touch(m, level + 1, set);
+  hit = lookup(c, set, block, &empty);
+  if(type == Access_D_READ)
+  {
+    c->stats.num_reads++;
+    if(hit >= 0)
+    {
+      use(m, way_at(c, set, hit));
+      return;
+    }
+    count_miss(c, empty, 0);
+    w = way_at(c, set, choose_way(m, c, set, empty));
+    evict(m, level, c, w);
+    w->block = block;
+    w->valid = 1;
+    w->dirty = 0;
+    use(m, w);
+    fetch(m, level, c, address);
+    return;
+  }
+
+  c->stats.num_writes++;
+  if(!through && !allocate)
+    return;
+  if(through && !allocate)
+  {
+    write_through(m, level, c, address);
+    if(hit >= 0)
+      use(m, way_at(c, set, hit));
+    else
+      count_miss(c, -1, 1);
+    return;
+  }
+  if(hit >= 0)
+  {
+    w = way_at(c, set, hit);
+    use(m, w);
+    if(!through)
+      w->dirty = 1;
+  }
+  else
+  {
+    count_miss(c, empty, 1);
+    if(through)
+    {
+      if(c->info.words_per_block > 1)
+        fetch(m, level, c, address);
+      way = choose_way(m, c, set, empty);
+    }
+    else
+    {
+      way = choose_way(m, c, set, empty);
+      evict(m, level, c, way_at(c, set, way));
+      if(c->info.words_per_block > 1)
+        fetch(m, level, c, address);
+    }
+    w = way_at(c, set, way);
+    w->block = block;
+    w->valid = 1;
+    w->dirty = !through;
+    use(m, w);
+  }
+  if(through)
+    write_through(m, level, c, address);
+}
+
+/* Runs one access through the model, adding the sets it touches to
+  m->touched */
+void ref_access(RefModel* m, AccessType type, addr_t address)
+{
+  RefCache* c = &m->caches[0];
+  unsigned long block;
+  int set, hit, empty;
+  RefWay* w;
+
+  if(type != Access_I_FETCH)
+  {
+    if(m->levels > 0)
+      access_level(m, 0, type, address);
+    return;
+  }
+  block = ref_block(c, address);
+  set = ref_set(c, block);
+  touch(m, 0, set);
+  c->stats.num_reads++;
+  hit = lookup(c, set, block, &empty);
+  if(hit >= 0)
+  {
+    use(m, way_at(c, set, hit));
+    return;
+  }
+  count_miss(c, empty, 0);
+  c->stats.words_read_mem += c->info.words_per_block;
+  w = way_at(c, set, choose_way(m, c, set, empty));
+  w->block = block;
+  w->valid = 1;
+  use(m, w);
+}
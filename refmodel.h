@@ -0,0 +1,80 @@
+#ifndef _REFMODEL_H_
+#define _REFMODEL_H_
+
+#include "cachesim.h"
+
+/* A slow reference model of the I-cache and D-cache levels, written from the
+rules below rather than from the simulator's code, for --check to run in
+lockstep with the real one. It keeps each way's block number, valid and
+dirty bits and a last-use time, and walks every way of a set on each access.
+
+	- An address's block number is address >> (2 + log2(words per block)).
+	  Its set is the block number modulo the number of sets for plain, mod
+	  and prime indexing (prime uses the largest prime at most the number of
+	  sets), and the block number XOR-folded in log2(sets)-bit pieces for xor.
+	- Ways fill in order, so a miss takes the first empty way. Once the set
+	  is full, LRU replaces the way used longest ago and random the way the
+	  simulator's random draw picks: the model takes the draws rather than
+	  making its own, and counts it as a divergence if it needs a draw that
+	  wasn't made or one is left over.
+	- A miss that finds an empty way is compulsory. Otherwise it is a
+	  conflict miss with one way and a capacity miss with more.
+	- Every hit and fill makes the way the most recently used.
+	- A read miss writes the dirty victim back to the level below (a write
+	  of its block), then reads the block from below (a read). words_read_mem
+	  and words_write_mem go up by the block size for each.
+	- A write-back, write-allocate write miss does the same, but only reads
+	  the block from below if it is more than one word; the way is left dirty.
+	- A write-through, write-allocate write miss first reads the block from
+	  below if it is more than one word, then fills the way. Hit or miss,
+	  the word is then written through.
+	- A write-through, write-no-allocate write writes the word through first
+	  and then only looks: a miss counts as a conflict miss with one way and
+	  a capacity miss with more.
+	- A write-back, write-no-allocate write is only counted.
+	- A write through is one word on words_write_mem and a write below.
+	- The I-cache is read like a D-cache level with nothing below it.
+
+Only bare hierarchies are modelled: no prefetchers, victim caches, write
+buffers, sectors, partitions, skewed caches, TLBs or extra cores. */
+
+#define REF_MAX_DRAWS 16
+#define REF_MAX_TOUCHED 16
+
+typedef struct
+{
+	unsigned long block;
+	int valid, dirty;
+	unsigned long long used;   /* last use, for LRU */
+} RefWay;
+
+typedef struct
+{
+	CacheInfo info;
+	int sets;
+	RefWay* ways;              /* sets * associativity */
+	CacheStats stats;
+} RefCache;
+
+typedef struct
+{
+	RefCache caches[4];        /* [0] is the I-cache, then the D-cache levels */
+	int levels;                /* D-cache levels */
+	unsigned long long clock;
+	int draws[REF_MAX_DRAWS];  /* the simulator's rand() results not used yet */
+	int num_draws, next_draw;
+	const char* error;         /* set when the model can't follow the simulator */
+	/* Sets touched since num_touched was last cleared, as cache and set
+	pairs */
+	int touched_cache[REF_MAX_TOUCHED], touched_set[REF_MAX_TOUCHED];
+	int num_touched;
+} RefModel;
+
+void ref_init(RefModel* m, const CacheInfo* icache, const CacheInfo* dcaches, int levels);
+void ref_draw(RefModel* m, int draw);
+void ref_access(RefModel* m, AccessType type, addr_t address);
+int ref_set(const RefCache* c, unsigned long block);
+unsigned long ref_block(const RefCache* c, addr_t address);
+int ref_rank(const RefCache* c, int set, int way);
+
+#endif
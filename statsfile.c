@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "statsfile.h"
+
+/*
+Usage:
+	./cachesim merge [-o file] [-j file] <stats file>...
+
+	-o  also write the total as a binary stats file
+	-j  also write the total as JSON
+
+See statsfile.h for the formats.
+*/
+
+static const char* index_names[] = { "plain", "xor", "mod", "prime", "skew" };
+static const char* cache_names[] = { "I", "L1", "L2", "L3" };
+
+static void put_u32(FILE* f, unsigned int v)
+{
+  int i;
+  for(i = 0; i < 4; i++)
+    fputc((v >> (8 * i)) & 0xff, f);
+}
+static void put_u64(FILE* f, unsigned long long v)
+{
+  int i;
+  for(i = 0; i < 8; i++)
+    fputc((v >> (8 * i)) & 0xff, f);
+}
+static int get_u32(FILE* f, unsigned int* v)
+{
+  unsigned char b[4];
+  if(fread(b, 1, 4, f) != 4)
+    return -1;
+  *v = b[0] | (b[1] << 8) | (b[2] << 16) | ((unsigned int)b[3] << 24);
+  return 0;
+}
+static int get_u64(FILE* f, unsigned long long* v)
+{
+  unsigned char b[8];
+  int i;
+  if(fread(b, 1, 8, f) != 8)
+    return -1;
+  *v = 0;
+  for(i = 7; i >= 0; i--)
+    *v = (*v << 8) | b[i];
+  return 0;
+}
+
+/* The counters in file order */
+static long long* counters(CacheStats* s, int i)
+{
+  long long* fields[10] =
+  {
+    &s->num_reads, &s->words_read_mem, &s->num_writes, &s->words_write_mem,
+    &s->compulsory_reads, &s->conflict_reads, &s->capacity_reads,
+    &s->compulsory_writes, &s->conflict_writes, &s->capacity_writes,
+  };
+  return fields[i];
+}
+
+int stats_write(const char* path, const SavedStats* s)
+{
+  FILE* f = fopen(path, "wb");
+  const CacheInfo* c;
+  CacheStats stats;
+  int x, i, length = strlen(s->command);
+
+  if(f == NULL)
+    return -1;
+  fwrite(STATS_MAGIC, 1, 8, f);
+  put_u32(f, STATS_VERSION);
+  put_u32(f, s->levels);
+  put_u32(f, s->shards);
+  put_u64(f, s->accesses);
+  put_u32(f, length);
+  fwrite(s->command, 1, length, f);
+  for(x = 0; x <= s->levels; x++)
+  {
+    c = &s->caches[x];
+    put_u32(f, c->num_blocks);
+    put_u32(f, c->words_per_block);
+    put_u32(f, c->associativity);
+    put_u32(f, c->replacement);
+    put_u32(f, c->write_scheme);
+    put_u32(f, c->allocate_scheme);
+    put_u32(f, c->index);
+    stats = s->stats[x];
+    for(i = 0; i < 10; i++)
+      put_u64(f, *counters(&stats, i));
+    put_u32(f, s->sets[x]);
+    for(i = 0; i < s->sets[x]; i++)
+      put_u64(f, s->set_misses[x][i]);
+  }
+  if(ferror(f))
+  {
+    fclose(f);
+    return -1;
+  }
+  return fclose(f) == 0 ? 0 : -1;
+}
+
+static double rate(long long misses, long long refs)
+{
+  return refs > 0 ? (double)misses / refs * 100 : 0.0;
+}
+int stats_write_json(const char* path, const SavedStats* s)
+{
+  FILE* f = fopen(path, "w");
+  const CacheInfo* c;
+  const CacheStats* t;
+  const char* p;
+  long long read_misses, write_misses;
+  int x, i;
+
+  if(f == NULL)
+    return -1;
+  fprintf(f, "{\"stats\":%d,\"command\":\"", STATS_VERSION);
+  for(p = s->command; *p != '\0'; p++)
+  {
+    if(*p == '"' || *p == '\\')
+      fputc('\\', f);
+    fputc((unsigned char)*p < ' ' ? ' ' : *p, f);
+  }
+  fprintf(f, "\",\"shards\":%d,\"accesses\":%llu,\"caches\":[", s->shards, s->accesses);
+  for(x = 0; x <= s->levels; x++)
+  {
+    c = &s->caches[x];
+    t = &s->stats[x];
+    read_misses = t->compulsory_reads + t->conflict_reads + t->capacity_reads;
+    write_misses = t->compulsory_writes + t->conflict_writes + t->capacity_writes;
+    fprintf(f, "%s{\"cache\":\"%s\",\"blocks\":%d,\"words_per_block\":%d,\"associativity\":%d,"
+      "\"replacement\":\"%c\",\"write\":\"%c\",\"allocate\":\"%c\",\"index\":\"%s\",",
+      x > 0 ? "," : "", cache_names[x], c->num_blocks, c->words_per_block, c->associativity,
+      "LR"[c->replacement], "BT"[c->write_scheme], "AN"[c->allocate_scheme], index_names[c->index]);
+    fprintf(f, "\"reads\":%lld,\"writes\":%lld,\"words_read_mem\":%lld,\"words_write_mem\":%lld,"
+      "\"compulsory_reads\":%lld,\"conflict_reads\":%lld,\"capacity_reads\":%lld,"
+      "\"compulsory_writes\":%lld,\"conflict_writes\":%lld,\"capacity_writes\":%lld,"
+      "\"read_misses\":%lld,\"read_miss_rate\":%.4f,\"write_misses\":%lld,\"write_miss_rate\":%.4f",
+      t->num_reads, t->num_writes, t->words_read_mem, t->words_write_mem,
+      t->compulsory_reads, t->conflict_reads, t->capacity_reads,
+      t->compulsory_writes, t->conflict_writes, t->capacity_writes,
+      read_misses, rate(read_misses, t->num_reads), write_misses, rate(write_misses, t->num_writes));
+    if(s->sets[x] != 0)
+    {
+      fprintf(f, ",\"set_misses\":[");
+      for(i = 0; i < s->sets[x]; i++)
+        fprintf(f, "%s%lld", i > 0 ? "," : "", s->set_misses[x][i]);
+      fprintf(f, "]");
+    }
+    fprintf(f, "}");
+  }
+  fprintf(f, "]}\n");
+  return fclose(f) == 0 ? 0 : -1;
+}
+
+/* Reads one cache's record; returns an error message or NULL */
+static const char* read_cache(FILE* f, SavedStats* s, int x)
+{
+  CacheInfo* c = &s->caches[x];
+  unsigned int v[8];
+  unsigned long long n;
+  int i;
+
+  for(i = 0; i < 7; i++)
+  {
+    if(get_u32(f, &v[i]) != 0)
+      return "is truncated";
+  }
+  c->num_blocks = v[0];
+  c->words_per_block = v[1];
+  c->associativity = v[2];
+  c->replacement = v[3];
+  c->write_scheme = v[4];
+  c->allocate_scheme = v[5];
+  c->index = v[6];
+  if(v[0] == 0 || v[0] > 1U << 30 || v[1] == 0 || v[2] == 0 || v[2] > v[0] ||
+    v[3] > Replacement_RANDOM || v[4] > Write_WRITE_THROUGH || v[5] > Allocate_NO_ALLOCATE || v[6] > Index_SKEW)
+    return "has an invalid cache configuration";
+  for(i = 0; i < 10; i++)
+  {
+    if(get_u64(f, &n) != 0)
+      return "is truncated";
+    *counters(&s->stats[x], i) = n;
+  }
+  if(get_u32(f, &v[7]) != 0)
+    return "is truncated";
+  if(v[7] > (unsigned int)c->num_blocks)
+    return "has a per-set histogram bigger than the cache";
+  s->sets[x] = v[7];
+  if(v[7] != 0)
+    s->set_misses[x] = malloc(sizeof(long long) * v[7]);
+  for(i = 0; i < s->sets[x]; i++)
+  {
+    if(get_u64(f, &n) != 0)
+      return "is truncated";
+    s->set_misses[x][i] = n;
+  }
+  return NULL;
+}
+/* Reads a binary stats file, saying what is wrong with it on stderr if it
+  can't */
+int stats_read(const char* path, SavedStats* s)
+{
+  FILE* f = fopen(path, "rb");
+  const char* error = NULL;
+  char magic[8];
+  unsigned int version, levels = 0, shards = 0, length = 0;
+  int x;
+
+  memset(s, 0, sizeof(SavedStats));
+  if(f == NULL)
+  {
+    fprintf(stderr, "Could not open stats file %s.\n", path);
+    return -1;
+  }
+  if(fread(magic, 1, 8, f) != 8 || memcmp(magic, STATS_MAGIC, 8) != 0 || get_u32(f, &version) != 0)
+    error = "isn't a cachesim stats file";
+  else if(version > STATS_VERSION)
+    error = "is from a newer version of cachesim";
+  else if(get_u32(f, &levels) != 0 || get_u32(f, &shards) != 0 || get_u64(f, &s->accesses) != 0 ||
+    get_u32(f, &length) != 0)
+    error = "is truncated";
+  else if(levels > 3 || length >= STATS_MAX_COMMAND)
+    error = "has an invalid header";
+  else if(fread(s->command, 1, length, f) != length)
+    error = "is truncated";
+  s->command[error == NULL ? length : 0] = '\0';
+  s->levels = levels;
+  s->shards = shards;
+  for(x = 0; x <= s->levels && error == NULL; x++)
+    error = read_cache(f, s, x);
+  fclose(f);
+  if(error == NULL)
+    return 0;
+  fprintf(stderr, "Stats file %s %s.\n", path, error);
+  stats_free(s);
+  return -1;
+}
+
+/* Adds s into into, if they come from the same hierarchy */
+int stats_add(SavedStats* into, const SavedStats* s, const char** why)
+{
+  CacheStats stats;
+  int x, i;
+
+  if(s->levels != into->levels || memcmp(s->caches, into->caches, sizeof(CacheInfo) * (s->levels + 1)) != 0)
+  {
+    *why = "is from a different cache hierarchy than the first";
+    return -1;
+  }
+  for(x = 0; x <= s->levels; x++)
+  {
+    if(s->sets[x] != into->sets[x])
+    {
+      *why = "doesn't have the same per-set histograms as the first";
+      return -1;
+    }
+  }
+  into->shards += s->shards;
+  into->accesses += s->accesses;
+  for(x = 0; x <= s->levels; x++)
+  {
+    stats = s->stats[x];
+    for(i = 0; i < 10; i++)
+      *counters(&into->stats[x], i) += *counters(&stats, i);
+    for(i = 0; i < s->sets[x]; i++)
+      into->set_misses[x][i] += s->set_misses[x][i];
+  }
+  return 0;
+}
+
+void stats_free(SavedStats* s)
+{
+  int x;
+  for(x = 0; x < 4; x++)
+  {
+    free(s->set_misses[x]);
+    s->set_misses[x] = NULL;
+    s->sets[x] = 0;
+  }
+}
+
+int merge_main(int argc, char** argv)
+{
+  const char* out_path = NULL;
+  const char* json_path = NULL;
+  const char* why;
+  SavedStats total, s;
+  int i, have = 0;
+
+  for(i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+      out_path = argv[++i];
+    else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+      json_path = argv[++i];
+    else if(argv[i][0] == '-')
+    {
+      fprintf(stderr, "Unknown or invalid merge option %s.\n", argv[i]);
+      return 1;
+    }
+    else
+    {
+      if(stats_read(argv[i], have ? &s : &total) != 0)
+        return 1;
+      if(have && stats_add(&total, &s, &why) != 0)
+      {
+        fprintf(stderr, "Stats file %s %s.\n", argv[i], why);
+        return 1;
+      }
+      if(have)
+        stats_free(&s);
+      have = 1;
+    }
+  }
+  if(!have)
+  {
+    fprintf(stderr, "Give merge at least one stats file.\n");
+    return 1;
+  }
+
+  print_saved_stats(&total);
+  if(out_path != NULL && stats_write(out_path, &total) != 0)
+  {
+    fprintf(stderr, "Could not write stats file %s.\n", out_path);
+    return 1;
+  }
+  if(json_path != NULL && stats_write_json(json_path, &total) != 0)
+  {
+    fprintf(stderr, "Could not write stats file %s.\n", json_path);
+    return 1;
+  }
+  stats_free(&total);
+  return 0;
+}
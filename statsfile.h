@@ -0,0 +1,66 @@
+#ifndef _STATSFILE_H_
+#define _STATSFILE_H_
+
+#include "cachesim.h"
+
+/* Saved statistics, so that runs over pieces of one trace or workload (split
+traces, workers that each take some of the sets, many hosts) can be added up
+afterwards. The simulator writes them with
+	--stats-out <file>    the binary format below, which merge reads
+	--stats-json <file>   the same as one line of JSON
+and --set-misses adds a histogram of misses per set for every cache (none may
+be skewed).
+
+	./cachesim merge [-o file] [-j file] <stats file>...
+
+adds up binary stats files from runs of the same hierarchy, prints the total
+in the simulator's usual text form with the miss rates worked out again from
+the summed counters, and can write the total back out as binary (so merges can
+be done as a tree) or as JSON.
+
+The binary format is little-endian with no padding:
+	"CSIMSTAT"        8 bytes
+	version           u32, STATS_VERSION
+	levels            u32, D-cache levels
+	shards            u32, how many runs were added up into this one
+	accesses          u64
+	command length    u32, then the command line of the first run
+	then for the I-cache and each D-cache level:
+		num_blocks, words_per_block, associativity, replacement,
+		write_scheme, allocate_scheme, index            7 x u32
+		num_reads, words_read_mem, num_writes, words_write_mem,
+		compulsory_reads, conflict_reads, capacity_reads,
+		compulsory_writes, conflict_writes, capacity_writes  10 x u64
+		sets              u32, 0 without --set-misses
+		misses per set    sets x u64
+
+A reader refuses a newer version than its own. Only single-core runs can be
+saved. */
+
+#define STATS_MAGIC "CSIMSTAT"
+#define STATS_VERSION 1
+#define STATS_MAX_COMMAND 4096
+
+typedef struct
+{
+	int levels;                   /* D-cache levels */
+	int shards;
+	unsigned long long accesses;
+	char command[STATS_MAX_COMMAND];
+	CacheInfo caches[4];          /* [0] is the I-cache, then the D-cache levels */
+	CacheStats stats[4];
+	int sets[4];                  /* 0 if there is no per-set histogram */
+	long long* set_misses[4];
+} SavedStats;
+
+int stats_write(const char* path, const SavedStats* s);
+int stats_write_json(const char* path, const SavedStats* s);
+int stats_read(const char* path, SavedStats* s);
+int stats_add(SavedStats* into, const SavedStats* s, const char** why);
+void stats_free(SavedStats* s);
+int merge_main(int argc, char** argv);
+
+/* In cachesim.c: prints saved statistics like a run would */
+void print_saved_stats(const SavedStats* s);
+
+#endif
@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timing.h"
+
+typedef struct
+{
+	unsigned long block;
+	unsigned long long ready;
+} Mshr;
+
+typedef struct
+{
+	unsigned long long accesses;    /* demand accesses that reached this unit */
+	unsigned long long cycles;      /* their total time from arrival to data */
+	unsigned long long misses;      /* primary misses, each taking an MSHR */
+	unsigned long long merged;      /* secondary misses merged into an MSHR */
+	unsigned long long full_stalls; /* times every MSHR was busy */
+	unsigned long long full_cycles; /* cycles the core waited for one */
+} TimingStats;
+
+int timing_enabled;
+
+static TimingInfo timing_info[TIMING_UNITS] =
+{
+	{ 1, 0, 8 }, { 2, 0, 8 }, { 10, 0, 8 }, { 30, 0, 8 },
+};
+static MemoryTimingInfo memory_info = { 100, 1.0 };
+static TimingStats timing_stats[TIMING_UNITS];
+static Mshr* mshrs[TIMING_UNITS];
+static int num_dlevels;
+
+static unsigned long long now;          /* cycle the next access issues */
+static unsigned long long last_ready;   /* latest completion so far */
+static double memory_free;              /* cycle memory can start a transfer */
+static unsigned long long memory_reads, memory_busy_words;
+static unsigned long long total_accesses, total_latency, ifetch_stall_cycles;
+static long memory_override = -1;       /* latency from the DRAM model */
+static int memory_modelled;             /* whether the DRAM model is in use */
+
+static const char* unit_names[TIMING_UNITS] = { "I-Cache", "L1 D-Cache", "L2 D-Cache", "L3 D-Cache" };
+
+/* Parses "2:12:16:4" into unit and info. Returns 0 on success. */
+int parse_timing(const char* spec, int* unit, TimingInfo* info)
+{
+  char which;
+  int converted;
+
+  *info = (TimingInfo){ 0, 0, 8 };
+  converted = sscanf(spec, "%c:%d:%d:%d", &which, &info->hit_latency, &info->mshrs, &info->miss_penalty);
+  if(converted < 2)
+    return -1;
+  if(which == 'I')
+    *unit = 0;
+  else if(which >= '1' && which <= '3')
+    *unit = which - '0';
+  else
+    return -1;
+  if(info->hit_latency < 0 || info->mshrs < 1 || info->miss_penalty < 0)
+    return -1;
+  return 0;
+}
+/* Parses "200:4" into info. Returns 0 on success. */
+int parse_memory_timing(const char* spec, MemoryTimingInfo* info)
+{
+  info->words_per_cycle = 1.0;
+  if(sscanf(spec, "%d:%lf", &info->latency, &info->words_per_cycle) < 1)
+    return -1;
+  if(info->latency < 0 || info->words_per_cycle <= 0)
+    return -1;
+  return 0;
+}
+
+void timing_configure(int unit, const TimingInfo* info)
+{
+  timing_info[unit] = *info;
+  timing_enabled = 1;
+}
+void timing_configure_memory(const MemoryTimingInfo* info)
+{
+  memory_info = *info;
+  timing_enabled = 1;
+}
+void timing_setup(int dlevels)
+{
+  int u;
+  num_dlevels = dlevels;
+  for(u = 0; u < TIMING_UNITS; u++)
+    mshrs[u] = calloc(timing_info[u].mshrs, sizeof(Mshr));
+}
+
+/* Returns the MSHR tracking block at a unit if it is still in flight at
+  cycle t, or NULL */
+static Mshr* find_mshr(int unit, unsigned long block, unsigned long long t)
+{
+  int i;
+  for(i = 0; i < timing_info[unit].mshrs; i++)
+  {
+    if(mshrs[unit][i].ready > t && mshrs[unit][i].block == block)
+      return &mshrs[unit][i];
+  }
+  return NULL;
+}
+/* Returns a free MSHR at cycle t, or the one that frees up first */
+static Mshr* free_mshr(int unit, unsigned long long t)
+{
+  Mshr* first = &mshrs[unit][0];
+  int i;
+  for(i = 0; i < timing_info[unit].mshrs; i++)
+  {
+    if(mshrs[unit][i].ready <= t)
+      return &mshrs[unit][i];
+    if(mshrs[unit][i].ready < first->ready)
+      first = &mshrs[unit][i];
+  }
+  return first;
+}
+/* Puts words on the memory bus no earlier than cycle t and returns when the
+  transfer finishes */
+static double memory_transfer(double t, int words)
+{
+  double start = t > memory_free ? t : memory_free;
+  memory_free = start + words / memory_info.words_per_cycle;
+  memory_busy_words += words;
+  return memory_free;
+}
+
+/* Times one demand access. served is how deep it went: the index of the
+  level that hit (0 for the I-cache or L1), or the number of levels if it
+  went all the way to memory. blocks holds the block number at each unit.
+  fill_words and writeback_words are what the access moved to and from
+  memory, which uses up memory bandwidth. */
+void timing_access(AccessType type, int served, const unsigned long* blocks,
+	int fill_words, int writeback_words)
+{
+  int first = (type == Access_I_FETCH) ? 0 : 1;
+  int last = (type == Access_I_FETCH) ? 1 : 1 + num_dlevels;
+  unsigned long long issue = now, core = now, t = now, arrive[TIMING_UNITS], ready;
+  Mshr* merge = NULL;
+  Mshr* m;
+  int u, missed_to = first + served;
+
+  /* Walk down through the levels that missed */
+  for(u = first; u < missed_to; u++)
+  {
+    arrive[u] = t;
+    timing_stats[u].accesses++;
+    merge = find_mshr(u, blocks[u], t);
+    if(merge != NULL)
+    {
+      /* Secondary miss; it finishes when the primary one does */
+      timing_stats[u].merged++;
+      break;
+    }
+    m = free_mshr(u, t);
+    if(m->ready > t)
+    {
+      /* Every MSHR is busy; the core waits for the first to free up */
+      timing_stats[u].full_stalls++;
+      timing_stats[u].full_cycles += m->ready - t;
+      core += m->ready - t;
+      t = m->ready;
+    }
+    timing_stats[u].misses++;
+    t += timing_info[u].hit_latency + timing_info[u].miss_penalty;
+  }
+
+  if(merge != NULL)
+  {
+    ready = merge->ready > t ? merge->ready : t;
+    u++;
+  }
+  else if(missed_to < last)
+  {
+    /* Hit, but the block may still be on its way from an earlier miss */
+    arrive[u] = t;
+    timing_stats[u].accesses++;
+    t += timing_info[u].hit_latency;
+    merge = find_mshr(u, blocks[u], t);
+    if(merge != NULL)
+    {
+      timing_stats[u].merged++;
+      t = merge->ready;
+    }
+    ready = t;
+    u++;
+  }
+  else if(memory_override >= 0)
+  {
+    /* The DRAM model already accounted for the transfers */
+    memory_reads++;
+    ready = t + memory_override;
+    fill_words = writeback_words = 0;
+  }
+  else
+  {
+    memory_reads++;
+    ready = (unsigned long long)(memory_transfer(t + memory_info.latency, fill_words) + 0.999);
+    fill_words = 0;
+  }
+  memory_override = -1;
+  if(fill_words + writeback_words > 0)
+    memory_transfer(issue, fill_words + writeback_words);
+
+  /* Every level that took a primary miss holds an MSHR until the data is back */
+  while(--u >= first)
+  {
+    if(u < missed_to && (merge == NULL || find_mshr(u, blocks[u], arrive[u]) != merge))
+    {
+      m = free_mshr(u, arrive[u]);
+      m->block = blocks[u];
+      m->ready = ready;
+    }
+    timing_stats[u].cycles += ready - arrive[u];
+  }
+
+  total_accesses++;
+  total_latency += ready - issue;
+  if(ready > last_ready)
+    last_ready = ready;
+
+  /* Fetches block the core until they arrive; data accesses only hold it up
+    while waiting for an MSHR */
+  now = core + 1;
+  if(type == Access_I_FETCH && ready > now)
+  {
+    ifetch_stall_cycles += ready - now;
+    now = ready;
+  }
+}
+
+/* Makes the next access that goes to memory take cycles there instead of
+  using the simple latency and bandwidth model */
+void timing_memory_latency(long cycles)
+{
+  memory_override = cycles;
+  memory_modelled = 1;
+}
+/* The cycle the next access issues */
+unsigned long long timing_now()
+{
+  return now;
+}
+
+void print_timing()
+{
+  unsigned long long total = now > last_ready ? now : last_ready;
+  int u;
+
+  printf("\n\nTiming:\n");
+  printf("\tTotal cycles: %llu\n\tStall cycles: %llu\n", total, total > total_accesses ? total - total_accesses : 0);
+  printf("\t\tI-fetch stalls: %llu\n", ifetch_stall_cycles);
+  printf("\tAMAT: %.2f cycles\n", total_accesses ? (double)total_latency / total_accesses : 0.0);
+  for(u = 0; u <= num_dlevels; u++)
+  {
+    if(timing_stats[u].accesses == 0)
+      continue;
+    printf("\t%s:\n", unit_names[u]);
+    printf("\t\tAMAT: %.2f cycles\n", (double)timing_stats[u].cycles / timing_stats[u].accesses);
+    printf("\t\tPrimary misses: %llu\n\t\tMerged secondary misses: %llu\n", timing_stats[u].misses, timing_stats[u].merged);
+    printf("\t\tMSHR-full stalls: %llu (%llu cycles)\n", timing_stats[u].full_stalls, timing_stats[u].full_cycles);
+  }
+  if(memory_modelled)
+  {
+    printf("\tMemory:\n\t\tReads: %llu (data transfers are in the DRAM report)\n", memory_reads);
+    return;
+  }
+  printf("\tMemory:\n\t\tReads: %llu\n\t\tWords transferred: %llu\n", memory_reads, memory_busy_words);
+  printf("\t\tBandwidth used: %.3f words/cycle\n", total ? (double)memory_busy_words / total : 0.0);
+}
@@ -0,0 +1,54 @@
+#ifndef _TIMING_H_
+#define _TIMING_H_
+
+#include "cachesim.h"
+
+/* Cycle-level timing on top of the functional simulation. It is turned on by
+giving any latency on the command line:
+	-L <cache>:<hit latency>[:<mshrs>[:<miss penalty>]]
+	-M <memory latency>[:<words per cycle>]
+
+<cache> is I for the I-cache or 1, 2, 3 for a D-cache level. The miss penalty
+is extra cycles a miss spends at that level on top of the hit latency (tag
+check, fill). Unset levels default to 1, 2, 10 and 30 cycle hits with 8
+MSHRs; memory defaults to 100 cycles and 1 word per cycle.
+
+The core issues one access per cycle in trace order. Instruction fetches block
+until they are served; data accesses don't, so several misses can be in
+flight. Each level has a bounded number of MSHRs: a miss on a block that is
+already in flight merges into its MSHR, and a miss that finds them all busy
+stalls the core until one frees up. Memory serves one request at a time at
+the configured bandwidth, and writebacks to memory use that bandwidth too.
+With --dram the DRAM model (dram.h) takes over memory for data accesses and
+-M only applies to instruction fetches. */
+
+typedef struct
+{
+	int hit_latency;
+	int miss_penalty;
+	int mshrs;
+} TimingInfo;
+
+typedef struct
+{
+	int latency;
+	double words_per_cycle;
+} MemoryTimingInfo;
+
+/* Unit 0 is the I-cache and 1..3 the D-cache levels */
+#define TIMING_UNITS 4
+
+extern int timing_enabled;
+
+int parse_timing(const char* spec, int* unit, TimingInfo* info);
+int parse_memory_timing(const char* spec, MemoryTimingInfo* info);
+void timing_configure(int unit, const TimingInfo* info);
+void timing_configure_memory(const MemoryTimingInfo* info);
+void timing_setup(int num_dlevels);
+void timing_access(AccessType type, int served, const unsigned long* blocks,
+	int fill_words, int writeback_words);
+void timing_memory_latency(long cycles);
+unsigned long long timing_now();
+void print_timing();
+
+#endif
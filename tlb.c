@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tlb.h"
+
+typedef struct
+{
+	TlbInfo info;
+	int sets;
+	unsigned long* keys;       /* page number and size + 1; 0 is empty */
+	unsigned long* last_used;
+	unsigned long clock;
+	unsigned long long accesses, misses;
+	unsigned long long misses_by_size[3];
+} Tlb;
+
+typedef struct
+{
+	addr_t start, end;
+	PageSize size;
+} PageRange;
+
+#define MAX_PAGE_RANGES 16
+
+int tlb_enabled;
+
+static Tlb tlbs[3];
+static PageSize default_page = Page_4K;
+static PageRange page_ranges[MAX_PAGE_RANGES];
+static int num_page_ranges;
+static unsigned long long walks, walk_refs;
+
+static const int page_shift[3] = { 12, 21, 30 };
+static const char* page_names[3] = { "4 KB", "2 MB", "1 GB" };
+static const char* tlb_names[3] = { "I-TLB", "D-TLB", "L2 TLB" };
+
+/* Parses "D:64:4" into which and info. Returns 0 on success. */
+int parse_tlb(const char* spec, int* which, TlbInfo* info)
+{
+  char name[4];
+  if(sscanf(spec, "%3[^:]:%d:%d", name, &info->entries, &info->associativity) != 3)
+    return -1;
+  if(strcmp(name, "I") == 0)
+    *which = TLB_I;
+  else if(strcmp(name, "D") == 0)
+    *which = TLB_D;
+  else if(strcmp(name, "L2") == 0)
+    *which = TLB_L2;
+  else
+    return -1;
+  if(info->entries < 1 || info->associativity < 1 || info->entries % info->associativity != 0)
+    return -1;
+  return 0;
+}
+
+static int parse_page_size(const char* s, PageSize* size)
+{
+  if(strncmp(s, "4K", 2) == 0)
+    *size = Page_4K;
+  else if(strncmp(s, "2M", 2) == 0)
+    *size = Page_2M;
+  else if(strncmp(s, "1G", 2) == 0)
+    *size = Page_1G;
+  else
+    return -1;
+  return 0;
+}
+
+/* Parses "4K,2M@0x10000000-0x20000000". Returns 0 on success. */
+int parse_pages(const char* spec)
+{
+  char buf[256];
+  char* item;
+  PageRange* r;
+
+  if(strlen(spec) >= sizeof(buf))
+    return -1;
+  strcpy(buf, spec);
+  item = strtok(buf, ",");
+  if(item == NULL || parse_page_size(item, &default_page) != 0 || item[2] != '\0')
+    return -1;
+  num_page_ranges = 0;
+  while((item = strtok(NULL, ",")) != NULL)
+  {
+    if(num_page_ranges == MAX_PAGE_RANGES)
+      return -1;
+    r = &page_ranges[num_page_ranges++];
+    if(parse_page_size(item, &r->size) != 0 || sscanf(item + 2, "@%lx-%lx", &r->start, &r->end) != 2 || r->end <= r->start)
+      return -1;
+  }
+  return 0;
+}
+
+void tlb_configure(int which, const TlbInfo* info)
+{
+  tlbs[which].info = *info;
+  tlb_enabled = 1;
+}
+
+int tlb_configured(int which)
+{
+  return tlbs[which].info.entries != 0;
+}
+
+void tlb_setup()
+{
+  int t;
+  for(t = 0; t < 3; t++)
+  {
+    if(!tlb_configured(t))
+      continue;
+    tlbs[t].sets = tlbs[t].info.entries / tlbs[t].info.associativity;
+    tlbs[t].keys = calloc(tlbs[t].info.entries, sizeof(unsigned long));
+    tlbs[t].last_used = calloc(tlbs[t].info.entries, sizeof(unsigned long));
+  }
+}
+
+static PageSize page_size(addr_t address)
+{
+  int i;
+  for(i = 0; i < num_page_ranges; i++)
+  {
+    if(address >= page_ranges[i].start && address < page_ranges[i].end)
+      return page_ranges[i].size;
+  }
+  return default_page;
+}
+
+/* Looks a page up in one TLB and fills it on a miss. Returns whether it hit. */
+static int tlb_lookup(Tlb* t, unsigned long page, PageSize size)
+{
+  unsigned long key = ((page << 2) | size) + 1;
+  unsigned long* keys = &t->keys[(page % t->sets) * t->info.associativity];
+  unsigned long* used = &t->last_used[(page % t->sets) * t->info.associativity];
+  int way, victim = 0;
+
+  t->accesses++;
+  for(way = 0; way < t->info.associativity; way++)
+  {
+    if(keys[way] == key)
+    {
+      used[way] = ++t->clock;
+      return 1;
+    }
+    if(used[way] < used[victim])
+      victim = way;
+  }
+  t->misses++;
+  t->misses_by_size[size]++;
+  keys[victim] = key;
+  used[victim] = ++t->clock;
+  return 0;
+}
+
+/* Translates an access through the I or D TLB and the L2 TLB. On a miss in
+  all of them fills walk with the page table entry addresses the walk loads
+  and returns how many there are; returns 0 on a hit. */
+int tlb_translate(int which, addr_t address, addr_t* walk)
+{
+  PageSize size = page_size(address);
+  unsigned long page = address >> page_shift[size];
+  int levels, l;
+
+  if(tlb_lookup(&tlbs[which], page, size))
+    return 0;
+  if(tlb_configured(TLB_L2) && tlb_lookup(&tlbs[TLB_L2], page, size))
+    return 0;
+
+  /* Level l of the table is indexed by the address bits above 39 - 9l */
+  levels = MAX_WALK_LEVELS - size;
+  for(l = 0; l < levels; l++)
+    walk[l] = PAGE_TABLE_BASE + ((addr_t)l << 24) + ((address >> (39 - 9 * l)) << 3);
+  walks++;
+  walk_refs += levels;
+  return levels;
+}
+
+void print_tlb()
+{
+  int t, s;
+  printf("\n\nTLBs:\n");
+  for(t = 0; t < 3; t++)
+  {
+    if(!tlb_configured(t))
+      continue;
+    printf("\t%s (%d entries, %d-way):\n", tlb_names[t], tlbs[t].info.entries, tlbs[t].info.associativity);
+    printf("\t\tAccesses: %llu\n\t\tMisses: %llu\n\t\tMiss rate: %.2f%%\n", tlbs[t].accesses, tlbs[t].misses,
+      tlbs[t].accesses ? 100.0 * tlbs[t].misses / tlbs[t].accesses : 0.0);
+    for(s = Page_4K; s <= Page_1G; s++)
+    {
+      if(tlbs[t].misses_by_size[s] != 0)
+        printf("\t\t\t%s page misses: %llu\n", page_names[s], tlbs[t].misses_by_size[s]);
+    }
+  }
+  printf("\tPage walks: %llu (%llu page table loads)\n", walks, walk_refs);
+}
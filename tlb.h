@@ -0,0 +1,53 @@
+#ifndef _TLB_H_
+#define _TLB_H_
+
+#include "cachesim.h"
+
+/* TLBs in front of the caches, set up with
+	-T <tlb>:<entries>:<associativity>
+where <tlb> is I or D for the first-level instruction and data TLBs, or L2
+for a second-level TLB both of them miss into. Entries are LRU and each holds
+one page of any size.
+
+Pages are 4 KB unless --pages says otherwise:
+	--pages <size>[,<size>@<start>-<end>...]
+gives the default page size and then address ranges backed by other sizes,
+e.g. 4K,2M@0x10000000-0x20000000,1G@0x40000000-0x80000000.
+
+A miss in every TLB walks a four-level radix page table: four loads for a
+4 KB page, three for 2 MB and two for 1 GB. With --page-walk those loads are
+sent through the D-caches as reads of the page table entries, which live at
+PAGE_TABLE_BASE with one 16 MB region per level, so walks for nearby pages
+share cache blocks. Addresses are not translated otherwise: the caches see
+the trace's addresses. */
+
+typedef struct
+{
+	int entries;
+	int associativity;
+} TlbInfo;
+
+typedef enum
+{
+	Page_4K,
+	Page_2M,
+	Page_1G,
+} PageSize;
+
+#define TLB_I 0
+#define TLB_D 1
+#define TLB_L2 2
+#define MAX_WALK_LEVELS 4
+#define PAGE_TABLE_BASE 0xC0000000UL
+
+extern int tlb_enabled;
+
+int parse_tlb(const char* spec, int* which, TlbInfo* info);
+int parse_pages(const char* spec);
+void tlb_configure(int which, const TlbInfo* info);
+int tlb_configured(int which);
+void tlb_setup();
+int tlb_translate(int which, addr_t address, addr_t* walk);
+void print_tlb();
+
+#endif
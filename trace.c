@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "trace.h"
+
+static const char* format_names[] =
+{
+	"auto",
+	"native",
+	"lackey",
+	"din",
+	"champsim",
+};
+
+const char* trace_format_name(TraceFormat format)
+{
+  return format_names[format];
+}
+
+int parse_trace_format(const char* name, TraceFormat* format)
+{
+  int f;
+  for(f = Trace_AUTO; f <= Trace_CHAMPSIM; f++)
+  {
+    if(strcmp(name, format_names[f]) == 0)
+    {
+      *format = f;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/* Moves the unread bytes to the front and reads once after them. Returns
+  how many bytes came in, 0 at the end of the input. */
+static size_t refill(TraceReader* r)
+{
+  ssize_t n;
+  if(r->eof)
+    return 0;
+  if(r->start > 0)
+  {
+    memmove(r->buffer, r->buffer + r->start, r->end - r->start);
+    r->end -= r->start;
+    r->start = 0;
+  }
+  do
+    n = read(r->fd, r->buffer + r->end, TRACE_BUFFER_BYTES - r->end);
+  while(n < 0 && errno == EINTR);
+  if(n <= 0)
+  {
+    r->eof = 1;
+    return 0;
+  }
+  r->end += n;
+  return n;
+}
+
+/* Returns the next line with its newline cut off, or NULL at the end. A line
+  longer than the whole buffer comes back in pieces. */
+static char* next_line(TraceReader* r)
+{
+  char* line;
+  char* newline;
+  while(1)
+  {
+    newline = memchr(r->buffer + r->start, '\n', r->end - r->start);
+    if(newline != NULL)
+    {
+      line = r->buffer + r->start;
+      *newline = '\0';
+      r->start = newline + 1 - r->buffer;
+      return line;
+    }
+    if(r->end - r->start == TRACE_BUFFER_BYTES || refill(r) == 0)
+    {
+      if(r->start == r->end)
+        return NULL;
+      line = r->buffer + r->start;
+      r->buffer[r->end] = '\0';
+      r->start = r->end;
+      return line;
+    }
+  }
+}
+
+static void emit(TraceReader* r, AccessType type, unsigned long long address)
+{
+  MemAccess* a = &r->pending[r->num_pending++];
+  a->type = type;
+  a->address = (addr_t)(address & 0xFFFFFFFFULL);
+  a->core = 0;
+}
+
+static void decode_native(TraceReader* r, const char* line)
+{
+  MemAccess* a = &r->pending[0];
+  addr_t address;
+  char type;
+  int core = 0;
+
+  if(sscanf(line, "0x%lx %c %d", &address, &type, &core) < 2)
+    return;
+
+  a->address = (addr_t)(address & 0xFFFFFFFFULL);
+  a->core = 0;
+  if(r->cores > 1)
+  {
+    if(core < 0 || core >= r->cores)
+    {
+      fprintf(stderr, "Malformed trace file: core %d out of range.\n", core);
+      exit(1);
+    }
+    a->core = core;
+  }
+  switch(type)
+  {
+    case 'R': a->type = Access_D_READ;  break;
+    case 'W': a->type = Access_D_WRITE; break;
+    case 'I': a->type = Access_I_FETCH; break;
+    default:
+      fprintf(stderr, "Malformed trace file: invalid access type '%c'.\n",
+        type);
+      exit(1);
+      break;
+  }
+  r->num_pending = 1;
+}
+
+static void decode_lackey(TraceReader* r, const char* line)
+{
+  unsigned long long address;
+  char kind;
+
+  if(line[0] == '=' || sscanf(line, " %c %llx", &kind, &address) != 2)
+    return;
+  switch(kind)
+  {
+    case 'I': emit(r, Access_I_FETCH, address); break;
+    case 'L': emit(r, Access_D_READ, address);  break;
+    case 'S': emit(r, Access_D_WRITE, address); break;
+    case 'M':
+      emit(r, Access_D_READ, address);
+      emit(r, Access_D_WRITE, address);
+      break;
+  }
+}
+
+static void decode_din(TraceReader* r, const char* line)
+{
+  unsigned long long address;
+  int label;
+
+  if(sscanf(line, "%d %llx", &label, &address) != 2)
+    return;
+  switch(label)
+  {
+    case 0: emit(r, Access_D_READ, address);  break;
+    case 1: emit(r, Access_D_WRITE, address); break;
+    case 2: emit(r, Access_I_FETCH, address); break;
+  }
+}
+
+static unsigned long long little_endian(const unsigned char* p)
+{
+  unsigned long long v = 0;
+  int i;
+  for(i = 7; i >= 0; i--)
+    v = (v << 8) | p[i];
+  return v;
+}
+/* Decodes one input_instr record: ip at 0, branch and register bytes, then
+  two destination and four source memory addresses from byte 16 on */
+static int decode_champsim(TraceReader* r)
+{
+  const unsigned char* p;
+  unsigned long long address;
+  int i;
+
+  while(r->end - r->start < CHAMPSIM_RECORD_BYTES)
+  {
+    if(refill(r) == 0)
+      return 0;
+  }
+  p = (const unsigned char*)r->buffer + r->start;
+  r->start += CHAMPSIM_RECORD_BYTES;
+  emit(r, Access_I_FETCH, little_endian(p));
+  for(i = 0; i < 4; i++)
+  {
+    if((address = little_endian(p + 32 + 8 * i)) != 0)
+      emit(r, Access_D_READ, address);
+  }
+  for(i = 0; i < 2; i++)
+  {
+    if((address = little_endian(p + 16 + 8 * i)) != 0)
+      emit(r, Access_D_WRITE, address);
+  }
+  return 1;
+}
+
+/* Guesses the format from what has been read so far */
+static TraceFormat detect_format(TraceReader* r)
+{
+  const unsigned char* p = (const unsigned char*)r->buffer + r->start;
+  const char* line;
+  size_t i, len, n = r->end - r->start;
+
+  for(i = 0; i < n && i < 4096; i++)
+  {
+    if(p[i] == 0 || p[i] >= 0x80)
+      return Trace_CHAMPSIM;
+  }
+  for(i = 0; i < n; i++)
+  {
+    line = (const char*)p + i;
+    while(i < n && p[i] != '\n')
+      i++;
+    len = (const char*)p + i - line;
+    if(len < 3 || line[0] == '=')
+      continue;
+    if(line[0] == '0' && line[1] == 'x')
+      return Trace_NATIVE;
+    if((line[0] == 'I' && line[1] == ' ') || (line[0] == ' ' && strchr("LSM", line[1]) && line[2] == ' '))
+      return Trace_LACKEY;
+    if(line[0] >= '0' && line[0] <= '4' && (line[1] == ' ' || line[1] == '\t'))
+      return Trace_DIN;
+    return Trace_NATIVE;
+  }
+  return Trace_NATIVE;
+}
+
+/* Opens a trace file, FIFO or - for standard input. Returns NULL if it
+  can't be opened. */
+TraceReader* trace_open(const char* path, TraceFormat format, int cores)
+{
+  TraceReader* r;
+  int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+
+  if(fd < 0)
+    return NULL;
+  r = calloc(1, sizeof(TraceReader));
+  if(r == NULL || (r->buffer = malloc(TRACE_BUFFER_BYTES + 1)) == NULL)
+  {
+    fprintf(stderr, "Out of memory for the trace buffer.\n");
+    exit(1);
+  }
+  r->fd = fd;
+  r->cores = cores;
+  r->format = format;
+  if(format == Trace_AUTO)
+  {
+    while(r->end < 4096 && refill(r) != 0)
+      ;
+    r->format = detect_format(r);
+  }
+  return r;
+}
+
+/* Hands out the next access. Returns 0 at the end of the trace. */
+int trace_read(TraceReader* r, MemAccess* access)
+{
+  char* line;
+  while(r->next_pending == r->num_pending)
+  {
+    r->num_pending = r->next_pending = 0;
+    if(r->format == Trace_CHAMPSIM)
+    {
+      if(!decode_champsim(r))
+        return 0;
+      continue;
+    }
+    if((line = next_line(r)) == NULL)
+      return 0;
+    if(r->format == Trace_LACKEY)
+      decode_lackey(r, line);
+    else if(r->format == Trace_DIN)
+      decode_din(r, line);
+    else
+      decode_native(r, line);
+  }
+  *access = r->pending[r->next_pending++];
+  return 1;
+}
+
+void trace_close(TraceReader* r)
+{
+  if(r->fd != STDIN_FILENO)
+    close(r->fd);
+  free(r->buffer);
+  free(r);
+}
@@ -0,0 +1,55 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include "cachesim.h"
+
+/* Trace input. A trace is read from a file, a FIFO or, given as -, standard
+input, TRACE_BUFFER_BYTES at a time, so a tracer can pipe straight into the
+simulator. The format is worked out from the start of the input unless
+--format gives it:
+	native    0x00001000 R, with an optional core number after the type
+	lackey    valgrind --tool=lackey --trace-mem=yes output: I, L, S and M
+	          (a load and then a store) lines; the == lines are skipped
+	din       DineroIV din: <label> <hex address>, where label 0 is a read,
+	          1 a write and 2 an instruction fetch; 3 and 4 are skipped
+	champsim  ChampSim binary input_instr records of 64 bytes: a fetch of
+	          the instruction, then its source and destination memory
+	          operands as reads and writes. Decompress .xz traces into a
+	          pipe first.
+Input with NUL or non-ASCII bytes near the start is taken as champsim. Text
+is told apart by its first line that isn't blank or a == line. Lines that
+can't be parsed are skipped. Addresses are cut to 32 bits like everywhere
+else in the simulator, and access sizes are ignored: each access touches the
+word at its address. */
+
+#define TRACE_BUFFER_BYTES (1 << 20)
+#define CHAMPSIM_RECORD_BYTES 64
+
+typedef enum
+{
+	Trace_AUTO,
+	Trace_NATIVE,
+	Trace_LACKEY,
+	Trace_DIN,
+	Trace_CHAMPSIM,
+} TraceFormat;
+
+typedef struct
+{
+	int fd;
+	TraceFormat format;
+	int cores;               /* native core numbers must be below this */
+	char* buffer;
+	size_t start, end;       /* unread bytes */
+	int eof;
+	MemAccess pending[7];    /* accesses decoded but not handed out yet */
+	int num_pending, next_pending;
+} TraceReader;
+
+int parse_trace_format(const char* name, TraceFormat* format);
+const char* trace_format_name(TraceFormat format);
+TraceReader* trace_open(const char* path, TraceFormat format, int cores);
+int trace_read(TraceReader* r, MemAccess* access);
+void trace_close(TraceReader* r);
+
+#endif
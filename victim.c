@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "victim.h"
+
+static const char* victim_names[] =
+{
+	"none",
+	"victim",
+	"miss",
+};
+
+const char* victim_name(VictimKind kind)
+{
+  return victim_names[kind];
+}
+
+/* Parses "1:victim:8" into level (0-based) and info. Returns 0 on success. */
+int parse_victim(const char* spec, int* level, VictimInfo* info)
+{
+  char kind[16];
+  int k;
+
+  if(sscanf(spec, "%d:%15[a-z]:%d", level, kind, &info->entries) != 3)
+    return -1;
+  if(*level < 1 || *level > 3)
+    return -1;
+  (*level)--;
+  for(k = Victim_VICTIM; k <= Victim_MISS; k++)
+  {
+    if(strcmp(kind, victim_names[k]) == 0)
+      break;
+  }
+  if(k > Victim_MISS)
+    return -1;
+  info->kind = k;
+  if(info->entries < 1 || info->entries > VICTIM_MAX_ENTRIES)
+    return -1;
+  return 0;
+}
+
+void victim_init(VictimCache* v, const VictimInfo* info)
+{
+  v->info = *info;
+  v->blocks = calloc(info->entries, sizeof(unsigned long));
+  v->last_used = calloc(info->entries, sizeof(unsigned long));
+  v->clock = 0;
+  memset(&v->stats, 0, sizeof(v->stats));
+}
+
+static int find_entry(VictimCache* v, unsigned long block)
+{
+  int i;
+  for(i = 0; i < v->info.entries; i++)
+  {
+    if(v->blocks[i] == block + 1)
+      return i;
+  }
+  return -1;
+}
+
+/* Looks for a block the level just missed on. A victim cache gives the block
+  up since it goes back into the level; a miss cache keeps its copy. */
+int victim_probe(VictimCache* v, unsigned long block)
+{
+  int i = find_entry(v, block);
+  v->stats.probes++;
+  if(i < 0)
+    return 0;
+  v->stats.hits++;
+  if(v->info.kind == Victim_VICTIM)
+    v->blocks[i] = 0;
+  else
+    v->last_used[i] = ++v->clock;
+  return 1;
+}
+
+/* Adds a block, replacing an empty or the least recently used entry */
+void victim_insert(VictimCache* v, unsigned long block)
+{
+  int i = find_entry(v, block), j;
+  if(i < 0)
+  {
+    i = 0;
+    for(j = 0; j < v->info.entries; j++)
+    {
+      if(v->blocks[j] == 0)
+      {
+        i = j;
+        break;
+      }
+      if(v->last_used[j] < v->last_used[i])
+        i = j;
+    }
+    v->blocks[i] = block + 1;
+    v->stats.insertions++;
+  }
+  v->last_used[i] = ++v->clock;
+}
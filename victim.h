@@ -0,0 +1,55 @@
+#ifndef _VICTIM_H_
+#define _VICTIM_H_
+
+/* Small fully-associative caches that sit beside a D-cache level to catch
+its conflict misses, attached with
+	-V <level>:<kind>:<entries>
+
+The kind can be:
+	victim  holds the blocks the level evicts. A miss that hits in it swaps
+	        the block back in without going to the next level (Jouppi 1990).
+	miss    holds copies of the blocks the level most recently fetched, so a
+	        block that ping-pongs between two sets is only fetched once.
+
+Both are LRU. They hold clean copies: a dirty block is still written back
+when the level evicts it, so they only save read traffic. */
+
+typedef enum
+{
+	Victim_NONE,
+	Victim_VICTIM,
+	Victim_MISS,
+} VictimKind;
+
+typedef struct
+{
+	VictimKind kind;
+	int entries;
+} VictimInfo;
+
+typedef struct
+{
+	long long probes;       /* misses in the level that looked here */
+	long long hits;         /* of those, ones that found the block */
+	long long insertions;
+	long long words_saved;  /* words the level didn't have to read from below */
+} VictimStats;
+
+typedef struct
+{
+	VictimInfo info;
+	unsigned long* blocks;     /* block number + 1; 0 is empty */
+	unsigned long* last_used;
+	unsigned long clock;
+	VictimStats stats;
+} VictimCache;
+
+#define VICTIM_MAX_ENTRIES 256
+
+int parse_victim(const char* spec, int* level, VictimInfo* info);
+const char* victim_name(VictimKind kind);
+void victim_init(VictimCache* v, const VictimInfo* info);
+int victim_probe(VictimCache* v, unsigned long block);
+void victim_insert(VictimCache* v, unsigned long block);
+
+#endif
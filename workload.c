@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "workload.h"
+
+#define ZIPF_BLOCK_BYTES 64
+#define CODE_BASE 0x00400000UL
+#define DATA_BASE 0x10000000UL
+
+static const char* workload_names[] =
+{
+	"seq", "stride", "random", "zipf", "chase", "mixed",
+};
+
+const char* workload_name(WorkloadKind kind)
+{
+  return workload_names[kind];
+}
+
+/* xorshift64* - the generators keep their own random state so they never
+  disturb the rand() sequence used for random replacement */
+static unsigned long long next_random(Workload* w)
+{
+  w->rng ^= w->rng >> 12;
+  w->rng ^= w->rng << 25;
+  w->rng ^= w->rng >> 27;
+  return w->rng * 0x2545F4914F6CDD1DULL;
+}
+/* Returns a random double in [0, 1) */
+static double next_uniform(Workload* w)
+{
+  return (next_random(w) >> 11) * (1.0 / 9007199254740992.0);
+}
+/* Parses a size with an optional K, M or G suffix */
+static unsigned long parse_size(const char* s)
+{
+  char* end;
+  unsigned long n = strtoul(s, &end, 0);
+  if(*end == 'K' || *end == 'k')
+    n <<= 10;
+  else if(*end == 'M' || *end == 'm')
+    n <<= 20;
+  else if(*end == 'G' || *end == 'g')
+    n <<= 30;
+  return n;
+}
+
+/* Fills in info from a spec string like "zipf:footprint=1M:reads=0.7".
+  Returns 0 on success and -1 if the spec is malformed. */
+int parse_workload(const char* spec, WorkloadInfo* info)
+{
+  char buf[256];
+  char* item;
+  char* value;
+  int k;
+
+  memset(info, 0, sizeof(*info));
+  info->base = DATA_BASE;
+  info->footprint = 1 << 20;
+  info->stride = 64;
+  info->read_ratio = 1.0;
+  info->zipf_alpha = 0.99;
+  info->ifetch_ratio = 0.4;
+  info->code_footprint = 64 << 10;
+  info->count = 1000000;
+  info->seed = 1;
+
+  if(strlen(spec) >= sizeof(buf))
+    return -1;
+  strcpy(buf, spec);
+
+  item = strtok(buf, ":");
+  if(item == NULL)
+    return -1;
+  for(k = 0; k <= Workload_MIXED; k++)
+  {
+    if(strcmp(item, workload_names[k]) == 0)
+      break;
+  }
+  if(k > Workload_MIXED)
+    return -1;
+  info->kind = k;
+
+  while((item = strtok(NULL, ":")) != NULL)
+  {
+    value = strchr(item, '=');
+    if(value == NULL)
+      return -1;
+    *value++ = '\0';
+    if(strcmp(item, "footprint") == 0)
+      info->footprint = parse_size(value);
+    else if(strcmp(item, "stride") == 0)
+      info->stride = parse_size(value);
+    else if(strcmp(item, "reads") == 0)
+      info->read_ratio = atof(value);
+    else if(strcmp(item, "alpha") == 0)
+      info->zipf_alpha = atof(value);
+    else if(strcmp(item, "ifetch") == 0)
+      info->ifetch_ratio = atof(value);
+    else if(strcmp(item, "code") == 0)
+      info->code_footprint = parse_size(value);
+    else if(strcmp(item, "n") == 0)
+      info->count = parse_size(value);
+    else if(strcmp(item, "seed") == 0)
+      info->seed = strtoul(value, NULL, 0);
+    else
+      return -1;
+  }
+
+  if(info->footprint < 4 || info->stride < 4 || info->count == 0)
+    return -1;
+  if(info->read_ratio < 0.0 || info->read_ratio > 1.0)
+    return -1;
+  if(info->ifetch_ratio < 0.0 || info->ifetch_ratio > 1.0 || info->code_footprint < 4)
+    return -1;
+  if(info->zipf_alpha <= 0.0 || info->zipf_alpha == 1.0)
+    return -1;
+  return 0;
+}
+
+/* Precomputes the constants for Gray et al.'s Zipfian generator */
+static void setup_zipf(Workload* w)
+{
+  unsigned long i;
+  double theta = w->info.zipf_alpha;
+  double zeta2 = 1.0 + pow(0.5, theta);
+
+  w->zeta_n = 0;
+  for(i = 1; i <= w->items; i++)
+    w->zeta_n += 1.0 / pow((double)i, theta);
+  w->zipf_theta = theta;
+  w->zipf_half = pow(0.5, theta);
+  w->zipf_eta = (1.0 - pow(2.0 / w->items, 1.0 - theta)) / (1.0 - zeta2 / w->zeta_n);
+}
+/* Returns a block rank in [0, items) where rank 0 is the hottest */
+static unsigned long next_zipf(Workload* w)
+{
+  double u = next_uniform(w);
+  double uz = u * w->zeta_n;
+  unsigned long rank;
+
+  if(uz < 1.0)
+    return 0;
+  if(uz < 1.0 + w->zipf_half)
+    return 1;
+  rank = (unsigned long)(w->items * pow(w->zipf_eta * u - w->zipf_eta + 1.0, 1.0 / (1.0 - w->zipf_theta)));
+  return rank < w->items ? rank : w->items - 1;
+}
+/* Returns a zipf-distributed data address. The hot blocks are scattered over
+  the footprint so they don't all land in neighbouring sets. */
+static addr_t next_zipf_address(Workload* w)
+{
+  unsigned long block = next_zipf(w);
+  if((w->items & (w->items - 1)) == 0)
+    block = (block * 0x9E3779B1UL) & (w->items - 1);
+  return w->info.base + block * ZIPF_BLOCK_BYTES + (next_random(w) % (ZIPF_BLOCK_BYTES / 4)) * 4;
+}
+
+void workload_init(Workload* w, const WorkloadInfo* info)
+{
+  unsigned long i, j, tmp;
+
+  memset(w, 0, sizeof(*w));
+  w->info = *info;
+  w->rng = 0x9E3779B97F4A7C15ULL ^ (info->seed * 0xBF58476D1CE4E5B9ULL);
+  if(w->rng == 0)
+    w->rng = 1;
+  w->pc = CODE_BASE;
+
+  switch(info->kind)
+  {
+    case Workload_SEQUENTIAL:
+    case Workload_RANDOM:
+      w->items = info->footprint / 4;
+      break;
+    case Workload_STRIDED:
+      w->items = info->footprint / info->stride;
+      break;
+    case Workload_ZIPF:
+    case Workload_MIXED:
+      w->items = info->footprint / ZIPF_BLOCK_BYTES;
+      if(w->items < 2)
+        w->items = 2;
+      setup_zipf(w);
+      break;
+    case Workload_POINTER_CHASE:
+      w->items = info->footprint / info->stride;
+      if(w->items < 2)
+        w->items = 2;
+      /* Sattolo's algorithm gives a single cycle through every node */
+      w->next_node = malloc(sizeof(unsigned int) * w->items);
+      for(i = 0; i < w->items; i++)
+        w->next_node[i] = i;
+      for(i = w->items - 1; i > 0; i--)
+      {
+        j = next_random(w) % i;
+        tmp = w->next_node[i];
+        w->next_node[i] = w->next_node[j];
+        w->next_node[j] = tmp;
+      }
+      break;
+  }
+  if(w->items == 0)
+    w->items = 1;
+}
+
+/* Produces the next access. Returns 0 once info.count accesses have been
+  generated. */
+int workload_next(Workload* w, AccessType* type, addr_t* address)
+{
+  if(w->generated == w->info.count)
+    return 0;
+  w->generated++;
+
+  if(w->info.kind == Workload_MIXED && next_uniform(w) < w->info.ifetch_ratio)
+  {
+    /* Straight-line code with the occasional taken branch */
+    if(next_uniform(w) < 0.1)
+      w->pc = CODE_BASE + (next_random(w) % (w->info.code_footprint / 4)) * 4;
+    else if((w->pc += 4) >= CODE_BASE + w->info.code_footprint)
+      w->pc = CODE_BASE;
+    *type = Access_I_FETCH;
+    *address = w->pc;
+    return 1;
+  }
+
+  switch(w->info.kind)
+  {
+    case Workload_SEQUENTIAL:
+      *address = w->info.base + w->position * 4;
+      w->position = (w->position + 1) % w->items;
+      break;
+    case Workload_STRIDED:
+      *address = w->info.base + w->position * w->info.stride;
+      w->position = (w->position + 1) % w->items;
+      break;
+    case Workload_RANDOM:
+      *address = w->info.base + (next_random(w) % w->items) * 4;
+      break;
+    case Workload_ZIPF:
+    case Workload_MIXED:
+      *address = next_zipf_address(w);
+      break;
+    case Workload_POINTER_CHASE:
+      *address = w->info.base + (addr_t)w->position * w->info.stride;
+      w->position = w->next_node[w->position];
+      break;
+  }
+  *address &= 0xFFFFFFFFUL;
+
+  if(w->info.read_ratio >= 1.0 || next_uniform(w) < w->info.read_ratio)
+    *type = Access_D_READ;
+  else
+    *type = Access_D_WRITE;
+  return 1;
+}
+
+void workload_free(Workload* w)
+{
+  free(w->next_node);
+  w->next_node = NULL;
+}
+
+/* cachesim gen <workload> - writes the workload out as a trace file */
+int gen_main(int argc, char** argv)
+{
+  WorkloadInfo info;
+  Workload w;
+  AccessType type;
+  addr_t address;
+  static const char type_chars[] = { 'I', 'R', 'W' };
+
+  if(argc != 2 || parse_workload(argv[1], &info) != 0)
+  {
+    fprintf(stderr, "Usage: cachesim gen <workload>\n");
+    return 1;
+  }
+
+  workload_init(&w, &info);
+  while(workload_next(&w, &type, &address))
+    printf("0x%08lx %c\n", address, type_chars[type]);
+  workload_free(&w);
+  return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef _WORKLOAD_H_
+#define _WORKLOAD_H_
+
+#include "cachesim.h"
+
+/* Synthetic workload generators. These produce the same (type, address)
+stream a trace file would, so they can be fed straight into handle_access()
+without writing a trace to disk first.
+
+A workload is described by a string like:
+	zipf:footprint=1048576:reads=0.7:n=1000000
+
+The first item is the kind of workload:
+	seq     sequential word-by-word sweep over the footprint
+	stride  fixed stride sweep over the footprint (stride=<bytes>)
+	random  uniform random words in the footprint
+	zipf    Zipfian hot set over the blocks of the footprint (alpha=<skew>)
+	chase   pointer chase through a random cycle of nodes (stride=<node bytes>)
+	mixed   instruction fetches interleaved with a zipf data stream
+	        (ifetch=<fraction of accesses that are I-fetches, 0 to 1>,
+	        code=<bytes of code, at least 4>)
+
+The rest are optional key=value settings:
+	footprint  bytes of data touched (default 1048576)
+	reads      fraction of data accesses that are reads (default 1.0)
+	n          number of accesses to generate (default 1000000)
+	seed       random seed (default 1)
+*/
+
+typedef enum
+{
+	Workload_SEQUENTIAL,
+	Workload_STRIDED,
+	Workload_RANDOM,
+	Workload_ZIPF,
+	Workload_POINTER_CHASE,
+	Workload_MIXED,
+} WorkloadKind;
+
+typedef struct
+{
+	WorkloadKind kind;
+	addr_t base;               /* first data address */
+	unsigned long footprint;   /* bytes of data touched */
+	int stride;                /* bytes, for stride and chase */
+	double read_ratio;         /* fraction of data accesses that are reads */
+	double zipf_alpha;         /* skew for zipf and mixed */
+	double ifetch_ratio;       /* fraction of I-fetches for mixed */
+	unsigned long code_footprint; /* bytes of code for mixed */
+	unsigned long count;       /* number of accesses to generate */
+	unsigned long seed;
+} WorkloadInfo;
+
+typedef struct
+{
+	WorkloadInfo info;
+	unsigned long long rng;
+	unsigned long items;       /* words, strides, blocks or nodes */
+	unsigned long position;
+	unsigned long generated;
+	addr_t pc;
+	unsigned int* next_node;   /* pointer chase cycle */
+	double zeta_n, zipf_eta, zipf_theta, zipf_half;
+} Workload;
+
+const char* workload_name(WorkloadKind kind);
+int parse_workload(const char* spec, WorkloadInfo* info);
+void workload_init(Workload* w, const WorkloadInfo* info);
+int workload_next(Workload* w, AccessType* type, addr_t* address);
+void workload_free(Workload* w);
+int gen_main(int argc, char** argv);
+
+#endif
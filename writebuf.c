@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "writebuf.h"
+
+/* Parses "1:8:drain=eager" into level (0-based) and info. Returns 0 on
+  success. */
+int parse_write_buffer(const char* spec, int* level, WriteBufferInfo* info)
+{
+  char buf[128];
+  char* item;
+  char* value;
+
+  if(strlen(spec) >= sizeof(buf))
+    return -1;
+  strcpy(buf, spec);
+
+  item = strtok(buf, ":");
+  if(item == NULL || sscanf(item, "%d", level) != 1 || *level < 1 || *level > 3)
+    return -1;
+  (*level)--;
+  item = strtok(NULL, ":");
+  if(item == NULL || sscanf(item, "%d", &info->entries) != 1)
+    return -1;
+  info->drain = Drain_FULL;
+  info->high_water = info->entries;
+
+  while((item = strtok(NULL, ":")) != NULL)
+  {
+    value = strchr(item, '=');
+    if(value == NULL)
+      return -1;
+    *value++ = '\0';
+    if(strcmp(item, "drain") == 0 && strcmp(value, "full") == 0)
+      info->drain = Drain_FULL;
+    else if(strcmp(item, "drain") == 0 && strcmp(value, "eager") == 0)
+      info->drain = Drain_EAGER;
+    else if(strcmp(item, "hwm") == 0)
+      info->high_water = atoi(value);
+    else
+      return -1;
+  }
+
+  if(info->entries < 1 || info->entries > WRITE_BUFFER_MAX_ENTRIES)
+    return -1;
+  if(info->high_water < 0 || info->high_water > info->entries)
+    return -1;
+  return 0;
+}
+
+void write_buffer_init(WriteBuffer* b, const WriteBufferInfo* info)
+{
+  b->info = *info;
+  b->entries = calloc(info->entries, sizeof(WriteBufferEntry));
+  b->used = 0;
+  b->seq = 0;
+  memset(&b->stats, 0, sizeof(b->stats));
+}
+
+WriteBufferEntry* write_buffer_find(WriteBuffer* b, unsigned long block)
+{
+  int i;
+  for(i = 0; i < b->info.entries; i++)
+  {
+    if(b->entries[i].block == block + 1)
+      return &b->entries[i];
+  }
+  return NULL;
+}
+
+WriteBufferEntry* write_buffer_oldest(WriteBuffer* b)
+{
+  WriteBufferEntry* oldest = NULL;
+  int i;
+  for(i = 0; i < b->info.entries; i++)
+  {
+    if(b->entries[i].block != 0 && (oldest == NULL || b->entries[i].seq < oldest->seq))
+      oldest = &b->entries[i];
+  }
+  return oldest;
+}
+
+/* Buffers a store to word of block. Returns 0 if it went in, or -1 if the
+  buffer is full and an entry has to be drained first. */
+int write_buffer_add(WriteBuffer* b, unsigned long block, int word)
+{
+  WriteBufferEntry* e = write_buffer_find(b, block);
+  int i;
+
+  if(word > 63)
+    word = 63;
+  if(e != NULL)
+  {
+    b->stats.stores++;
+    b->stats.combined++;
+    e->words |= 1UL << word;
+    return 0;
+  }
+  if(b->used == b->info.entries)
+    return -1;
+  for(i = 0; b->entries[i].block != 0; i++)
+    ;
+  b->stats.stores++;
+  b->entries[i].block = block + 1;
+  b->entries[i].words = 1UL << word;
+  b->entries[i].seq = b->seq++;
+  b->used++;
+  return 0;
+}
+
+void write_buffer_remove(WriteBuffer* b, WriteBufferEntry* e)
+{
+  e->block = 0;
+  b->used--;
+}
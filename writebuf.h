@@ -0,0 +1,72 @@
+#ifndef _WRITEBUF_H_
+#define _WRITEBUF_H_
+
+/* A write buffer between a write-through D-cache level and the next one,
+attached with
+	-B <level>:<entries>[:drain=full|eager][:hwm=<n>]
+
+Stores to the level go into the buffer instead of straight down. A store to a
+block that already has an entry combines into it; otherwise it takes a free
+entry, and if there is none the oldest entry is drained first (a buffer-full
+stall). Draining sends one write per entry, carrying every word written to
+that block, to the next level.
+
+	drain=full   only drain when a new entry is needed (default)
+	drain=eager  also drain the oldest entry on every read of the level,
+	             as if the bus to the next level were idle then
+	hwm=<n>      drain whenever more than n entries are in use
+
+A read that misses on a block with a buffered entry drains that entry first,
+so the next level has the data (the read-after-write check). Whatever is
+still buffered at the end of the run is drained before the statistics. */
+
+typedef enum
+{
+	Drain_FULL,
+	Drain_EAGER,
+} DrainPolicy;
+
+typedef struct
+{
+	int entries;
+	DrainPolicy drain;
+	int high_water;
+} WriteBufferInfo;
+
+typedef struct
+{
+	long long stores;          /* stores that went into the buffer */
+	long long combined;        /* of those, ones that joined an existing entry */
+	long long full_stalls;     /* stores that found every entry busy */
+	long long drains;          /* writes sent to the next level */
+	long long words_drained;
+	long long raw_matches;     /* reads of a block with a buffered entry */
+	long long raw_drains;      /* of those, misses that had to drain it first */
+} WriteBufferStats;
+
+typedef struct
+{
+	unsigned long block;   /* block number + 1; 0 is empty */
+	unsigned long words;   /* bit per word written, words past 63 share the top bit */
+	unsigned long seq;     /* when the entry was allocated */
+} WriteBufferEntry;
+
+typedef struct
+{
+	WriteBufferInfo info;
+	WriteBufferEntry* entries;
+	int used;
+	unsigned long seq;
+	WriteBufferStats stats;
+} WriteBuffer;
+
+#define WRITE_BUFFER_MAX_ENTRIES 64
+
+int parse_write_buffer(const char* spec, int* level, WriteBufferInfo* info);
+void write_buffer_init(WriteBuffer* b, const WriteBufferInfo* info);
+WriteBufferEntry* write_buffer_find(WriteBuffer* b, unsigned long block);
+WriteBufferEntry* write_buffer_oldest(WriteBuffer* b);
+int write_buffer_add(WriteBuffer* b, unsigned long block, int word);
+void write_buffer_remove(WriteBuffer* b, WriteBufferEntry* e);
+
+#endif